@@ -4,167 +4,287 @@
 #include <time.h>
 #include <algorithm> 
 
-#include "Constants.h"
-#include "GoogleFinanceDataReader.h"
-#include "TradeState.h"
+#include "Backtest.h"
+#include "Optimizer.h"
+#include "ThreadPool.h"
 #include "Utils.h"
 
 using namespace std;
 
-typedef std::pair<tm, std::vector< ::finance::StockCandle> > StockCandlesForTimestamp;
+/*
+ * Validates that the compact candles replay exactly like the double precision candles. Every
+ * materialized candle is compared with its double counterpart and a backtest is run on both.
+ *
+ * returns bool: true if the candles and the backtest results are identical.
+ */
+bool ValidateCompactReplay(const ::finance::BacktestCriteria& criteria) {
+	bool valid = true;
+	std::vector<std::vector< ::finance::StockCandle> > multiple_stock_candles = GetMultipleStockCandles(criteria);
+	std::vector< ::finance::CompactStockCandles> multiple_compact_stock_candles = GetMultipleCompactStockCandles(criteria);
+	if(!::finance::AreCompactStockCandlesExact(multiple_compact_stock_candles)) {
+		valid = false;
+	}
 
-double GetCagr(tm start_time_struct, tm end_time_struct, 
-	double initial_capital, double final_capital) {
-	time_t start_time = mktime(&start_time_struct);
-	time_t end_time = mktime(&end_time_struct);
+	for(int i=0; i<(int) multiple_stock_candles.size(); i++) {
+		if(!::finance::ValidateCompactStockCandles(multiple_stock_candles[i], multiple_compact_stock_candles[i])) {
+			valid = false;
+		}
+	}
 
-	double years = ((double) end_time - start_time)/(60*60*24*365);
-	return (pow((final_capital/initial_capital), (1.0/years)) - 1)*100;
-}
+	double capital = Backtest(MergeStockCandles(multiple_stock_candles), ::finance::constants::kBacktestStartTime, 
+		::finance::kGoogleFinanceDateTimeFormat, ::finance::constants::kInitialCapital, criteria);
+	double compact_capital = Backtest(::finance::CompactMergedCandles(multiple_compact_stock_candles), ::finance::constants::kBacktestStartTime, 
+		::finance::kGoogleFinanceDateTimeFormat, ::finance::constants::kInitialCapital, criteria);
+	if(capital != compact_capital) {
+		std::cout << "Final capital mismatch: " << capital << " vs " << compact_capital << endl;
+		valid = false;
+	}
 
-double Backtest(const vector<StockCandlesForTimestamp>& merged_candles, 
-	const string& start_time_string, const string& date_time_format, 
-	double capital, ::finance::BacktestCriteria criteria) {
-	double initial_capital = capital;
-
-	/* Getting the date time for the start. */
-	tm start_time_struct;
-	strptime(start_time_string.c_str(), date_time_format.c_str(), &start_time_struct);
-	time_t start_time = mktime(&start_time_struct);
-
-	/* Skipping the timestamps before the start date. */
-	int index = merged_candles.size() - 1;
-	while(index >= 0) {
-		tm current_time_struct = merged_candles[index].first;
-		time_t current_time = mktime(&current_time_struct);
-		if(current_time >= start_time) {
-			break;
-		}
+	std::cout << "Compact replay " << (valid ? "matches" : "does not match") << " the double precision replay." << endl;
+	return valid;
+}
 
-		index--;
+/*
+ * Returns the checkpoint file for a backtest of the sweep, empty if checkpoints are disabled.
+ */
+string GetCheckpointFilename(const string& checkpoint_prefix, int sweep_index) {
+	if(checkpoint_prefix.empty()) {
+		return "";
 	}
 
-	::finance::TradeState state;
-	while(index >= 0) {
-		for(const ::finance::StockCandle& candle: merged_candles[index].second) {
-			capital = state.SellIfFitsCriteria(candle, capital, criteria);
-			capital = state.BuyIfFitsCriteria(candle, capital, criteria);
-		}
+	return checkpoint_prefix + "." + to_string(sweep_index);
+}
 
-		index--;
+/*
+ * Runs the backtests over the exit gains from 4% to 20%. The indexes and the fingerprints of the
+ * candles are built once, the buy signals do not depend on the exit gain.
+ */
+template <typename MergedCandles>
+void Sweep(const MergedCandles& merged_candles, ::finance::BacktestCriteria criteria, const string& checkpoint_prefix) {
+	::finance::StockCandleIndex stock_candle_index(merged_candles);
+	::finance::SignalIndex signal_index(merged_candles, criteria);
+	std::unique_ptr< ::finance::InputFingerprints> input_fingerprints;
+	if(!checkpoint_prefix.empty()) {
+		input_fingerprints.reset(new ::finance::InputFingerprints(merged_candles));
 	}
 
-	capital = state.GetFinalCapital(capital);
-	std::cout << "Exit gain: " << criteria.exit_gain_criteria.gain_percentage 
-		<< " Final capital: " << ((long long) capital) 
-		<< " Wins: " << state.GetWins() 
-		<< " Losses: " << state.GetLosses() 
-		<< " CAGR: " << GetCagr(start_time_struct, merged_candles[0].first, 
-			initial_capital, capital) << endl;
-	return capital;
+	for(int i=4; i <= 20; i++) {
+		criteria.exit_gain_criteria.gain_percentage = ((double)i)/100;
+		Backtest(merged_candles, ::finance::constants::kBacktestStartTime, 
+			::finance::kGoogleFinanceDateTimeFormat, ::finance::constants::kInitialCapital, criteria, 
+			GetCheckpointFilename(checkpoint_prefix, i), &stock_candle_index, &signal_index, nullptr, 
+			input_fingerprints.get());
+	}
 }
 
-vector<StockCandlesForTimestamp> MergeStockCandles(std::vector<std::vector< ::finance::StockCandle> > multiple_stock_candles) {
-	vector<StockCandlesForTimestamp> merged_candles;
+/*
+ * Returns the search space of the optimizer when no parameter is given on the command line.
+ */
+vector< ::finance::OptimizerParameter> GetDefaultOptimizerParameters() {
+	vector< ::finance::OptimizerParameter> parameters = {
+		{"marubozu_criteria.body_minimum_threshold", 0.005, 0.03},
+		{"marubozu_criteria.body_maximum_threshold", 0.03, 0.15},
+		{"marubozu_criteria.lower_shadow_threshold", 0, 0.01},
+		{"marubozu_criteria.upper_shadow_threshold", 0, 0.01},
+		{"exit_gain_criteria.gain_percentage", 0.02, 0.3},
+		{"buy_volume_criteria.average_volume_threshold", 0.5, 3}
+	};
+
+	return parameters;
+}
 
-	vector<int> indexes;
-	for(int i=0; i<multiple_stock_candles.size(); i++) {
-		indexes.push_back(multiple_stock_candles[i].size() - 1);
+/*
+ * Parses an optimizer parameter given as <field>:<minimum>:<maximum>.
+ *
+ * returns bool: true if the parameter is valid.
+ */
+bool ParseOptimizerParameter(const string& text, ::finance::OptimizerParameter* parameter) {
+	size_t first_colon = text.find(':');
+	size_t second_colon = text.find(':', first_colon + 1);
+	if(first_colon == string::npos || second_colon == string::npos) {
+		return false;
 	}
 
-	while(1) {
-		int start_index = -1;
-		for(int i=0; i<indexes.size(); i++) {
-			if(indexes[i] >= 0) {
-				start_index = i;
-				break;
-			}
-		}
+	parameter->field = text.substr(0, first_colon);
+	char* end;
+	string minimum = text.substr(first_colon + 1, second_colon - first_colon - 1);
+	parameter->minimum = strtod(minimum.c_str(), &end);
+	if(minimum.empty() || *end != '\0') {
+		return false;
+	}
 
-		if(start_index == -1) {
-			break;
-		}
+	string maximum = text.substr(second_colon + 1);
+	parameter->maximum = strtod(maximum.c_str(), &end);
+	return !maximum.empty() && *end == '\0';
+}
 
-		tm minimum_time_struct = multiple_stock_candles[start_index][indexes[start_index]].close_time;
-		time_t minimum_time = mktime(&multiple_stock_candles[start_index][indexes[start_index]].close_time);
-		for(int i=start_index; i<indexes.size(); i++) {
-			if(indexes[i] >= 0) {
-				time_t current_time = mktime(&multiple_stock_candles[i][indexes[i]].close_time);
-				if(current_time < minimum_time) {
-					minimum_time_struct = multiple_stock_candles[i][indexes[i]].close_time;
-					minimum_time = current_time;
-				}
-			}
+/*
+ * Searches for the criteria with the best CAGR, running the backtests of every generation on all
+ * the threads of the pool.
+ */
+template <typename MergedCandles>
+int Optimize(const MergedCandles& merged_candles, const ::finance::BacktestCriteria& criteria,
+	const vector< ::finance::OptimizerParameter>& parameters, const ::finance::OptimizerOptions& options, int num_threads) {
+	for(const ::finance::OptimizerParameter& parameter: parameters) {
+		/* The average volumes are computed when loading the candles, so the number of days is fixed. */
+		if(parameter.field == "buy_volume_criteria.num_days") {
+			std::cout << "buy_volume_criteria.num_days cannot be optimized, the candles were loaded with it." << endl;
+			return 1;
 		}
+	}
 
-		StockCandlesForTimestamp candles_for_timestamp;
-		candles_for_timestamp.first = minimum_time_struct;
-		vector< ::finance::StockCandle> candles;
-
-		for(int i=start_index; i<indexes.size(); i++) {
-			if(indexes[i] >= 0) {
-				time_t current_time = mktime(&multiple_stock_candles[i][indexes[i]].close_time);
-				if(current_time == minimum_time) {
-					candles.push_back(multiple_stock_candles[i][indexes[i]]);
-					indexes[i]--;
-				}
-			}
-		}
-		candles_for_timestamp.second = candles;
-		merged_candles.push_back(candles_for_timestamp);
+	::finance::ThreadPool thread_pool(num_threads);
+	::finance::StockCandleIndex stock_candle_index(merged_candles);
+	const MergedCandles* candles = &merged_candles;
+	const ::finance::StockCandleIndex* index = &stock_candle_index;
+	::finance::GeneticOptimizer optimizer(criteria, parameters, options, 
+		[candles, index](const ::finance::BacktestCriteria& backtest_criteria) {
+			return RunBacktest(*candles, ::finance::constants::kBacktestStartTime, 
+				::finance::kGoogleFinanceDateTimeFormat, ::finance::constants::kInitialCapital, backtest_criteria, 
+				"", index).cagr;
+		}, &thread_pool);
+
+	::finance::OptimizerResult result;
+	string error;
+	if(!optimizer.Optimize(&result, &error)) {
+		std::cout << "Failed to optimize: " << error << endl;
+		return 1;
 	}
 
-	std::reverse(merged_candles.begin(), merged_candles.end());
-	return merged_candles;
-} 
+	std::cout << "Best CAGR: " << result.best_score << " after " << result.num_evaluations 
+		<< " evaluations in " << result.num_generations << " generations." << endl;
+	for(int i=0; i<(int) parameters.size() && i<(int) result.best_values.size(); i++) {
+		std::cout << "  " << parameters[i].field << ": " << result.best_values[i] << endl;
+	}
 
-int main() {
-	::finance::BacktestCriteria criteria;
+	return 0;
+}
 
-	/* Setting the buy criteria. */
-	criteria.buy_criteria.enabled = true;
-	criteria.buy_criteria.criteria = ::finance::BuyCriteria::HIGH;
+/*
+ * Usage: Backtest [--compact | --validate-compact] [--checkpoint <prefix>]
+ *     [--rank <BODY|VOLUME_RATIO|MOMENTUM>] [--max-entries <n>]
+ *   Backtest --optimize [--compact] [--parameter <field>:<minimum>:<maximum>]... [--seed <n>]
+ *     [--max-evaluations <n>] [--max-seconds <n>] [--population <n>] [--threads <n>]
+ *
+ * --compact: runs the backtests on the compact candles (prices in ticks, derived fields computed on the fly),
+ *   or on the double precision candles if some prices are not exact in ticks.
+ * --validate-compact: checks that the compact candles give exactly the same trades as the double candles.
+ * --checkpoint: resumes every backtest of the sweep from <prefix>.<index> and updates it, so that
+ *   only the candles appended since the last run are processed.
+ * --rank: when several stocks signal a buy on the same day, buys them by decreasing score
+ *   instead of in the order of the candles.
+ * --max-entries: number of the best ranked signals bought per day, 1 by default, all if not positive.
+ *   Only valid with --rank.
+ * --optimize: searches for the criteria with the best CAGR with a genetic optimizer, over the given
+ *   parameters (the marubozu thresholds, exit gain and volume threshold by default). The search is
+ *   reproducible for a given seed unless it is limited by --max-seconds.
+ * --max-evaluations, --max-seconds: budget of the search, 1000 evaluations by default. Only the
+ *   time budget applies if --max-seconds is given alone.
+ */
+int main(int argc, char* argv[]) {
+	bool use_compact_candles = false;
+	bool validate_compact_candles = false;
+	string checkpoint_prefix;
+	bool optimize = false;
+	vector< ::finance::OptimizerParameter> optimizer_parameters;
+	::finance::OptimizerOptions optimizer_options;
+	bool max_evaluations_set = false;
+	int num_threads = 0;
+	::finance::BacktestCriteria criteria = GetDefaultBacktestCriteria();
+	bool max_entries_set = false;
+	for(int i=1; i<argc; i++) {
+		string arg = argv[i];
+		if(arg == "--compact") {
+			use_compact_candles = true;
+		} else if(arg == "--validate-compact") {
+			validate_compact_candles = true;
+		} else if(arg == "--checkpoint" && i+1 < argc) {
+			checkpoint_prefix = argv[++i];
+		} else if(arg == "--optimize") {
+			optimize = true;
+		} else if(arg == "--parameter" && i+1 < argc) {
+			::finance::OptimizerParameter parameter;
+			if(!ParseOptimizerParameter(argv[++i], &parameter)) {
+				std::cout << "Invalid parameter " << argv[i] << ", expected <field>:<minimum>:<maximum>" << endl;
+				return 1;
+			}
+			optimizer_parameters.push_back(parameter);
+		} else if(arg == "--seed" && i+1 < argc) {
+			optimizer_options.seed = strtoull(argv[++i], nullptr, 10);
+		} else if(arg == "--max-evaluations" && i+1 < argc) {
+			optimizer_options.max_evaluations = atoi(argv[++i]);
+			max_evaluations_set = true;
+		} else if(arg == "--max-seconds" && i+1 < argc) {
+			optimizer_options.max_seconds = atof(argv[++i]);
+		} else if(arg == "--population" && i+1 < argc) {
+			optimizer_options.population_size = atoi(argv[++i]);
+		} else if(arg == "--threads" && i+1 < argc) {
+			num_threads = atoi(argv[++i]);
+		} else if(arg == "--rank" && i+1 < argc) {
+			::finance::JsonValue score;
+			score.type = ::finance::JsonValue::STRING;
+			score.text = argv[++i];
+			string error;
+			if(!::finance::SetBacktestCriteriaField("ranking_criteria.score", score, &criteria, &error)) {
+				std::cout << "Invalid rank " << argv[i] << ", expected one of BODY, VOLUME_RATIO, MOMENTUM" << endl;
+				return 1;
+			}
+			criteria.ranking_criteria.enabled = true;
+		} else if(arg == "--max-entries" && i+1 < argc) {
+			criteria.ranking_criteria.max_entries = atoi(argv[++i]);
+			max_entries_set = true;
+		} else {
+			std::cout << "Usage: " << argv[0] << " [--compact | --validate-compact] [--checkpoint <prefix>]" << endl;
+			std::cout << "         [--rank <BODY|VOLUME_RATIO|MOMENTUM>] [--max-entries <n>]" << endl;
+			std::cout << "       " << argv[0] << " --optimize [--compact] [--parameter <field>:<minimum>:<maximum>]... [--seed <n>]" << endl;
+			std::cout << "         [--max-evaluations <n>] [--max-seconds <n>] [--population <n>] [--threads <n>]" << endl;
+			return 1;
+		}
+	}
 
-	/* Setting the marubozu criteria. */
-	criteria.marubozu_criteria.enabled = true;
-	criteria.marubozu_criteria.body_minimum_threshold = 0.01;
-	criteria.marubozu_criteria.body_maximum_threshold = 0.1;
-	criteria.marubozu_criteria.lower_shadow_threshold = 0.003;
-	criteria.marubozu_criteria.upper_shadow_threshold = 0.003;
+	if(max_entries_set && !criteria.ranking_criteria.enabled) {
+		std::cout << "--max-entries only applies to the ranked entries, use it with --rank." << endl;
+		return 1;
+	}
 
-	/* Setting the stop loss criteria. */
-	criteria.stop_loss_criteria.enabled = true;
-	criteria.stop_loss_criteria.type = ::finance::StoplossCriteria::LOW;
+	if(validate_compact_candles) {
+		return ValidateCompactReplay(criteria) ? 0 : 1;
+	}
 
-	/* Setting the exit gain criteria. */
-	criteria.exit_gain_criteria.enabled = true;
-	criteria.exit_gain_criteria.gain_percentage = 0.18;
+	/* The default evaluation budget would otherwise silently cap a time budget. */
+	if(optimizer_options.max_seconds > 0 && !max_evaluations_set) {
+		optimizer_options.max_evaluations = 0;
+	}
 
-	/* Setting the buy volume criteria. */
-	criteria.buy_volume_criteria.enabled = true;
-	criteria.buy_volume_criteria.num_days = 10;
-	criteria.buy_volume_criteria.average_volume_threshold = 1;
+	/* Rounding the prices to ticks would change the trades, the compact candles are only used if exact. */
+	std::vector< ::finance::CompactStockCandles> multiple_compact_stock_candles;
+	if(use_compact_candles) {
+		multiple_compact_stock_candles = GetMultipleCompactStockCandles(criteria);
+		if(!::finance::AreCompactStockCandlesExact(multiple_compact_stock_candles)) {
+			std::cout << "Falling back to the double precision candles." << endl;
+			use_compact_candles = false;
+		}
+	}
 
-	/* Setting the sell volume criteria. */
-	criteria.sell_volume_criteria.enabled = false;
+	if(optimize) {
+		if(optimizer_parameters.empty()) {
+			optimizer_parameters = GetDefaultOptimizerParameters();
+		}
 
-	/* Setting the risk criteria. */
-	criteria.risk_criteria.enabled = false;
-	criteria.risk_criteria.risk_percentage = 0.04;
+		if(use_compact_candles) {
+			return Optimize(::finance::CompactMergedCandles(multiple_compact_stock_candles), criteria, 
+				optimizer_parameters, optimizer_options, num_threads);
+		}
 
-	std::vector<std::vector< ::finance::StockCandle> > multiple_stock_candles;
-	for(string stock: ::finance::constants::kNifty50) {
-		std::vector< ::finance::StockCandle> candles = 
-		::finance::GetStockCandles("Data/Stock_OLHC/" + stock + ".csv", 
-			stock, criteria);
-		multiple_stock_candles.push_back(candles);
+		return Optimize(MergeStockCandles(GetMultipleStockCandles(criteria)), criteria, 
+			optimizer_parameters, optimizer_options, num_threads);
 	}
-	
-	for(int i=4; i <= 20; i++) {
-		criteria.exit_gain_criteria.gain_percentage = ((double)i)/100;
-		Backtest(MergeStockCandles(multiple_stock_candles), "6/22/2008 15:30:00", 
-			::finance::kGoogleFinanceDateTimeFormat, 100000, criteria);
+
+	if(use_compact_candles) {
+		Sweep(::finance::CompactMergedCandles(multiple_compact_stock_candles), criteria, checkpoint_prefix);
+		return 0;
 	}
 
+	Sweep(MergeStockCandles(GetMultipleStockCandles(criteria)), criteria, checkpoint_prefix);
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,437 @@
+#ifndef BACKTEST_H
+#define BACKTEST_H
+
+#include <iostream>
+#include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <memory>
+#include <limits>
+
+#include "CandleIndex.h"
+#include "Checkpoint.h"
+#include "CompactStockCandle.h"
+#include "Constants.h"
+#include "EntryRanker.h"
+#include "GoogleFinanceDataReader.h"
+#include "TradeState.h"
+
+using namespace std;
+
+typedef std::pair<tm, std::vector< ::finance::StockCandle> > StockCandlesForTimestamp;
+
+/*
+ * Result of a single backtest.
+ * final_capital: capital at the end, including the ongoing trades at their buy price.
+ */
+struct BacktestResult {
+	double final_capital;
+	int wins;
+	int losses;
+	double cagr;
+};
+
+double GetCagr(tm start_time_struct, tm end_time_struct, 
+	double initial_capital, double final_capital) {
+	time_t start_time = mktime(&start_time_struct);
+	time_t end_time = mktime(&end_time_struct);
+
+	double years = ((double) end_time - start_time)/(60*60*24*365);
+	return (pow((final_capital/initial_capital), (1.0/years)) - 1)*100;
+}
+
+/*
+ * Restores the state of a backtest from a checkpoint, if the checkpoint was taken with the same
+ * criteria, start time and capital, and the input up to the checkpoint has not changed since.
+ *
+ * input_fingerprints: fingerprints of the prefixes of the merged candles.
+ * index: set to the index of the first timestamp after the checkpoint.
+ * returns bool: true if the backtest was restored.
+ */
+bool ResumeFromCheckpoint(const string& checkpoint_filename, const ::finance::InputFingerprints& input_fingerprints, 
+	const ::finance::BacktestCriteria& criteria, time_t start_time, double initial_capital, 
+	::finance::TradeState* state, double* capital, int* index) {
+	::finance::BacktestCheckpoint checkpoint;
+	if(!checkpoint.Load(checkpoint_filename)) {
+		return false;
+	}
+
+	if(checkpoint.criteria_fingerprint != ::finance::GetCriteriaFingerprint(criteria) ||
+		checkpoint.start_time != start_time || checkpoint.initial_capital != initial_capital || 
+		checkpoint.num_timestamps < 0 || checkpoint.num_timestamps > input_fingerprints.GetNumTimestamps()) {
+		std::cout << "Checkpoint " << checkpoint_filename << " does not match the backtest, replaying from the start." << endl;
+		return false;
+	}
+
+	if(input_fingerprints.GetFingerprint(checkpoint.num_timestamps) != checkpoint.input_fingerprint) {
+		std::cout << "Input changed since checkpoint " << checkpoint_filename << ", replaying from the start." << endl;
+		return false;
+	}
+
+	*state = checkpoint.state;
+	*capital = checkpoint.capital;
+	*index = input_fingerprints.GetNumTimestamps() - checkpoint.num_timestamps - 1;
+	return true;
+}
+
+/*
+ * Ranks the buy signals of the timestamp for the stocks without an open position.
+ *
+ * max_entries: number of best ranked signals to keep, all of them if not positive.
+ * ranked_entries: set to the (score, position) of the kept signals, best first. Equal scores are
+ * ordered by position, so the ranking is deterministic. Only the kept signals are sorted.
+ */
+template <typename MergedCandles>
+void RankEntries(const MergedCandles& merged_candles, int index, 
+	const ::finance::StockCandleIndex& stock_candle_index, const ::finance::SignalIndex& signal_index, 
+	const ::finance::TradeState& state, const ::finance::EntryRanker& entry_ranker, int max_entries, 
+	vector<pair<double, int> >* ranked_entries) {
+	ranked_entries->clear();
+	for(int position: signal_index.GetSignalPositions(index)) {
+		const ::finance::StockCandle& candle = ::finance::GetCandle(merged_candles, index, position);
+		if(state.IsTradeOngoing(candle.symbol)) {
+			continue;
+		}
+
+		double score;
+		int lookback_days = entry_ranker.GetLookbackDays();
+		if(lookback_days > 0) {
+			int stock_id = stock_candle_index.GetStockId(index, position);
+			int candle_index = stock_candle_index.GetNextCandle(stock_id, index);
+			if(candle_index >= lookback_days) {
+				const ::finance::CandlePosition& lookback_position = 
+					stock_candle_index.GetCandlePositions(stock_id)[candle_index - lookback_days];
+				const ::finance::StockCandle& lookback_candle = 
+					::finance::GetCandle(merged_candles, lookback_position.index, lookback_position.position);
+				score = entry_ranker.GetScore(candle, &lookback_candle);
+			} else {
+				score = entry_ranker.GetScore(candle, nullptr);
+			}
+		} else {
+			score = entry_ranker.GetScore(candle, nullptr);
+		}
+
+		if(std::isnan(score)) {
+			score = -std::numeric_limits<double>::infinity();
+		}
+
+		ranked_entries->push_back(std::make_pair(score, position));
+	}
+
+	int num_entries = ranked_entries->size();
+	if(max_entries > 0 && max_entries < num_entries) {
+		num_entries = max_entries;
+	}
+
+	std::partial_sort(ranked_entries->begin(), ranked_entries->begin() + num_entries, ranked_entries->end(),
+		[](const pair<double, int>& first, const pair<double, int>& second) {
+			if(first.first != second.first) {
+				return first.first > second.first;
+			}
+
+			return first.second < second.second;
+		});
+	ranked_entries->resize(num_entries);
+}
+
+/*
+ * Runs the backtest over the merged candles, latest timestamp first.
+ *
+ * MergedCandles: either vector<StockCandlesForTimestamp> or ::finance::CompactMergedCandles,
+ * anything indexable into a StockCandlesForTimestamp with the accessors of CandleIndex.h.
+ * checkpoint_filename: if set, the backtest resumes from this checkpoint when it is still valid
+ * and only processes the timestamps appended since. The checkpoint is updated at the end.
+ * stock_candle_index, signal_index: indexes of the merged candles, built for this backtest if not
+ * given or if the signal index was built for different buy signal criteria.
+ * entry_ranker: ranks the buy signals of a day if the ranking criteria is enabled, the ranker of
+ * the ranking criteria score if not given.
+ * input_fingerprints: fingerprints of the merged candles for the checkpoint, built for this backtest
+ * if not given.
+ *
+ * Only the candles of the open positions and the buy signals are processed at every timestamp, in
+ * the same order as the candles of the timestamp, so that the cost of a timestamp does not depend
+ * on the number of stocks and the trades are the same as when processing every candle.
+ */
+template <typename MergedCandles>
+BacktestResult RunBacktest(const MergedCandles& merged_candles, 
+	const string& start_time_string, const string& date_time_format, 
+	double capital, const ::finance::BacktestCriteria& criteria, const string& checkpoint_filename = "",
+	const ::finance::StockCandleIndex* stock_candle_index = nullptr, const ::finance::SignalIndex* signal_index = nullptr,
+	const ::finance::EntryRanker* entry_ranker = nullptr, const ::finance::InputFingerprints* input_fingerprints = nullptr) {
+	double initial_capital = capital;
+	bool checkpoint_enabled = !checkpoint_filename.empty();
+
+	/* Getting the date time for the start. */
+	tm start_time_struct = tm();
+	strptime(start_time_string.c_str(), date_time_format.c_str(), &start_time_struct);
+	start_time_struct.tm_isdst = -1;
+	time_t start_time = mktime(&start_time_struct);
+
+	std::unique_ptr< ::finance::InputFingerprints> built_input_fingerprints;
+	if(checkpoint_enabled && input_fingerprints == nullptr) {
+		built_input_fingerprints.reset(new ::finance::InputFingerprints(merged_candles));
+		input_fingerprints = built_input_fingerprints.get();
+	}
+
+	::finance::TradeState state;
+	int index = merged_candles.size() - 1;
+	if(checkpoint_enabled) {
+		ResumeFromCheckpoint(checkpoint_filename, *input_fingerprints, 
+			criteria, start_time, initial_capital, &state, &capital, &index);
+	}
+
+	/*
+	 * Skipping the timestamps before the start date, also after resuming since the timestamps
+	 * appended after a checkpoint taken before the start date can still be before it.
+	 */
+	while(index >= 0 && ::finance::GetTime(merged_candles, index) < start_time) {
+		index--;
+	}
+
+	std::unique_ptr< ::finance::StockCandleIndex> built_stock_candle_index;
+	if(stock_candle_index == nullptr) {
+		built_stock_candle_index.reset(new ::finance::StockCandleIndex(merged_candles));
+		stock_candle_index = built_stock_candle_index.get();
+	}
+
+	std::unique_ptr< ::finance::SignalIndex> built_signal_index;
+	if(signal_index == nullptr || !signal_index->IsCompatible(criteria)) {
+		built_signal_index.reset(new ::finance::SignalIndex(merged_candles, criteria));
+		signal_index = built_signal_index.get();
+	}
+
+	std::unique_ptr< ::finance::EntryRanker> built_entry_ranker;
+	if(criteria.ranking_criteria.enabled && entry_ranker == nullptr) {
+		built_entry_ranker = ::finance::CreateEntryRanker(criteria.ranking_criteria);
+		entry_ranker = built_entry_ranker.get();
+	}
+
+	/*
+	 * The stocks with an open position and the index of their next candle. A stock sold during the
+	 * timestamp stays in active_stock_ids (is_listed) until the end of the timestamp, so that it is
+	 * not listed twice if it is bought again in the same timestamp.
+	 */
+	vector<int> active_stock_ids;
+	vector<bool> is_active(stock_candle_index->GetNumStocks(), false);
+	vector<bool> is_listed(stock_candle_index->GetNumStocks(), false);
+	vector<int> next_candles(stock_candle_index->GetNumStocks(), 0);
+	for(const string& symbol: state.GetOngoingSymbols()) {
+		int stock_id = stock_candle_index->GetStockId(symbol);
+		if(stock_id >= 0) {
+			active_stock_ids.push_back(stock_id);
+			is_active[stock_id] = true;
+			is_listed[stock_id] = true;
+			next_candles[stock_id] = stock_candle_index->GetNextCandle(stock_id, index);
+		}
+	}
+
+	/* Adds the stock of the candle to the open positions if it was bought, removes it if it was sold. */
+	auto update_active_stock = [&](int position, const ::finance::StockCandle& candle) {
+		int stock_id = stock_candle_index->GetStockId(index, position);
+		bool trade_ongoing = state.IsTradeOngoing(candle.symbol);
+		if(trade_ongoing && !is_listed[stock_id]) {
+			active_stock_ids.push_back(stock_id);
+			is_listed[stock_id] = true;
+			next_candles[stock_id] = stock_candle_index->GetNextCandle(stock_id, index);
+		}
+		is_active[stock_id] = trade_ongoing;
+	};
+
+	vector<int> positions;
+	vector<pair<double, int> > ranked_entries;
+	while(index >= 0) {
+		/* Gathering the candles of the open positions and the buy signals of the timestamp. */
+		positions = signal_index->GetSignalPositions(index);
+		for(int stock_id: active_stock_ids) {
+			const vector< ::finance::CandlePosition>& candle_positions = stock_candle_index->GetCandlePositions(stock_id);
+			if(next_candles[stock_id] < (int) candle_positions.size() && candle_positions[next_candles[stock_id]].index == index) {
+				positions.push_back(candle_positions[next_candles[stock_id]].position);
+			}
+		}
+
+		std::sort(positions.begin(), positions.end());
+		positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+
+		if(!criteria.ranking_criteria.enabled) {
+			for(int position: positions) {
+				const ::finance::StockCandle& candle = ::finance::GetCandle(merged_candles, index, position);
+				capital = state.SellIfFitsCriteria(candle, capital, criteria);
+				capital = state.BuyIfFitsCriteria(candle, capital, criteria);
+				update_active_stock(position, candle);
+			}
+		} else {
+			for(int position: positions) {
+				const ::finance::StockCandle& candle = ::finance::GetCandle(merged_candles, index, position);
+				capital = state.SellIfFitsCriteria(candle, capital, criteria);
+				update_active_stock(position, candle);
+			}
+
+			RankEntries(merged_candles, index, *stock_candle_index, *signal_index, state, 
+				*entry_ranker, criteria.ranking_criteria.max_entries, &ranked_entries);
+			for(const pair<double, int>& ranked_entry: ranked_entries) {
+				const ::finance::StockCandle& candle = ::finance::GetCandle(merged_candles, index, ranked_entry.second);
+				capital = state.BuyIfFitsCriteria(candle, capital, criteria);
+				update_active_stock(ranked_entry.second, candle);
+			}
+		}
+
+		/* Dropping the closed positions and moving the open ones past this timestamp. */
+		int num_active_stocks = 0;
+		for(int stock_id: active_stock_ids) {
+			if(!is_active[stock_id]) {
+				is_listed[stock_id] = false;
+				continue;
+			}
+
+			const vector< ::finance::CandlePosition>& candle_positions = stock_candle_index->GetCandlePositions(stock_id);
+			if(next_candles[stock_id] < (int) candle_positions.size() && candle_positions[next_candles[stock_id]].index == index) {
+				next_candles[stock_id]++;
+			}
+			active_stock_ids[num_active_stocks++] = stock_id;
+		}
+		active_stock_ids.resize(num_active_stocks);
+		index--;
+	}
+
+	if(checkpoint_enabled) {
+		::finance::BacktestCheckpoint checkpoint;
+		checkpoint.criteria_fingerprint = ::finance::GetCriteriaFingerprint(criteria);
+		checkpoint.start_time = start_time;
+		checkpoint.initial_capital = initial_capital;
+		checkpoint.num_timestamps = merged_candles.size();
+		checkpoint.input_fingerprint = input_fingerprints->GetFingerprint(merged_candles.size());
+		checkpoint.capital = capital;
+		checkpoint.state = state;
+		if(!checkpoint.Save(checkpoint_filename)) {
+			std::cout << "Failed to write checkpoint " << checkpoint_filename << endl;
+		}
+	}
+
+	BacktestResult result;
+	result.final_capital = state.GetFinalCapital(capital);
+	result.wins = state.GetWins();
+	result.losses = state.GetLosses();
+	result.cagr = GetCagr(start_time_struct, ::finance::GetTimestamp(merged_candles, 0), initial_capital, result.final_capital);
+	return result;
+}
+
+/*
+ * Runs the backtest and prints its result, see RunBacktest.
+ *
+ * returns double: the final capital.
+ */
+template <typename MergedCandles>
+double Backtest(const MergedCandles& merged_candles, 
+	const string& start_time_string, const string& date_time_format, 
+	double capital, ::finance::BacktestCriteria criteria, const string& checkpoint_filename = "",
+	const ::finance::StockCandleIndex* stock_candle_index = nullptr, const ::finance::SignalIndex* signal_index = nullptr,
+	const ::finance::EntryRanker* entry_ranker = nullptr, const ::finance::InputFingerprints* input_fingerprints = nullptr) {
+	BacktestResult result = RunBacktest(merged_candles, start_time_string, date_time_format, 
+		capital, criteria, checkpoint_filename, stock_candle_index, signal_index, entry_ranker, input_fingerprints);
+	std::cout << "Exit gain: " << criteria.exit_gain_criteria.gain_percentage 
+		<< " Final capital: " << ((long long) result.final_capital) 
+		<< " Wins: " << result.wins 
+		<< " Losses: " << result.losses 
+		<< " CAGR: " << result.cagr << endl;
+	return result.final_capital;
+}
+
+/*
+ * Merges the candles of the stocks into timestamps, latest first, see ::finance::MergeCloseTimes.
+ */
+vector<StockCandlesForTimestamp> MergeStockCandles(std::vector<std::vector< ::finance::StockCandle> > multiple_stock_candles) {
+	vector<vector<time_t> > multiple_close_times;
+	for(std::vector< ::finance::StockCandle>& stock_candles: multiple_stock_candles) {
+		vector<time_t> close_times;
+		for(::finance::StockCandle& candle: stock_candles) {
+			close_times.push_back(mktime(&candle.close_time));
+		}
+		multiple_close_times.push_back(close_times);
+	}
+
+	vector<StockCandlesForTimestamp> merged_candles;
+	for(const pair<time_t, vector<pair<int, int> > >& merged_close_time: ::finance::MergeCloseTimes(multiple_close_times)) {
+		StockCandlesForTimestamp candles_for_timestamp;
+		for(const pair<int, int>& candle_index: merged_close_time.second) {
+			candles_for_timestamp.second.push_back(multiple_stock_candles[candle_index.first][candle_index.second]);
+		}
+		candles_for_timestamp.first = candles_for_timestamp.second[0].close_time;
+		merged_candles.push_back(candles_for_timestamp);
+	}
+
+	return merged_candles;
+}
+
+/*
+ * Returns the criteria used for the backtests unless overridden.
+ */
+::finance::BacktestCriteria GetDefaultBacktestCriteria() {
+	::finance::BacktestCriteria criteria;
+
+	/* Setting the buy criteria. */
+	criteria.buy_criteria.enabled = true;
+	criteria.buy_criteria.criteria = ::finance::BuyCriteria::HIGH;
+
+	/* Setting the marubozu criteria. */
+	criteria.marubozu_criteria.enabled = true;
+	criteria.marubozu_criteria.body_minimum_threshold = 0.01;
+	criteria.marubozu_criteria.body_maximum_threshold = 0.1;
+	criteria.marubozu_criteria.lower_shadow_threshold = 0.003;
+	criteria.marubozu_criteria.upper_shadow_threshold = 0.003;
+
+	/* Setting the stop loss criteria. */
+	criteria.stop_loss_criteria.enabled = true;
+	criteria.stop_loss_criteria.type = ::finance::StoplossCriteria::LOW;
+
+	/* Setting the exit gain criteria. */
+	criteria.exit_gain_criteria.enabled = true;
+	criteria.exit_gain_criteria.gain_percentage = 0.18;
+
+	/* Setting the buy volume criteria. */
+	criteria.buy_volume_criteria.enabled = true;
+	criteria.buy_volume_criteria.num_days = 10;
+	criteria.buy_volume_criteria.average_volume_threshold = 1;
+
+	/* Setting the sell volume criteria. */
+	criteria.sell_volume_criteria.enabled = false;
+
+	/* Setting the risk criteria. */
+	criteria.risk_criteria.enabled = false;
+	criteria.risk_criteria.risk_percentage = 0.04;
+
+	/* Setting the ranking criteria. */
+	criteria.ranking_criteria.enabled = false;
+	criteria.ranking_criteria.score = ::finance::RankingCriteria::VOLUME_RATIO;
+	criteria.ranking_criteria.max_entries = 1;
+	criteria.ranking_criteria.momentum_days = 20;
+
+	return criteria;
+}
+
+/*
+ * Reads the candles of all the stocks of the universe from the data directory.
+ */
+std::vector<std::vector< ::finance::StockCandle> > GetMultipleStockCandles(const ::finance::BacktestCriteria& criteria) {
+	std::vector<std::vector< ::finance::StockCandle> > multiple_stock_candles;
+	for(string stock: ::finance::constants::kNifty50) {
+		multiple_stock_candles.push_back(::finance::GetStockCandles(
+			::finance::constants::kStockDataDirectory + stock + ".csv", stock, criteria));
+	}
+
+	return multiple_stock_candles;
+}
+
+/*
+ * Reads the compact candles of all the stocks of the universe from the data directory.
+ */
+std::vector< ::finance::CompactStockCandles> GetMultipleCompactStockCandles(const ::finance::BacktestCriteria& criteria) {
+	std::vector< ::finance::CompactStockCandles> multiple_stock_candles;
+	for(string stock: ::finance::constants::kNifty50) {
+		multiple_stock_candles.push_back(::finance::GetCompactStockCandles(
+			::finance::constants::kStockDataDirectory + stock + ".csv", stock, criteria));
+	}
+
+	return multiple_stock_candles;
+}
+
+#endif
\ No newline at end of file
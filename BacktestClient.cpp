@@ -0,0 +1,114 @@
+#include <iostream>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "Json.h"
+
+using namespace std;
+
+const string kDefaultSocketPath = "/tmp/finance-backtest.sock";
+
+/*
+ * Sends the request to the daemon and prints the streamed results until the request is done.
+ *
+ * returns bool: true if the request succeeded.
+ */
+bool SendRequest(int socket_fd, const string& request, string* buffer) {
+	string data = request + "\n";
+	size_t sent = 0;
+	while(sent < data.size()) {
+		ssize_t count = send(socket_fd, data.c_str() + sent, data.size() - sent, MSG_NOSIGNAL);
+		if(count <= 0) {
+			std::cerr << "Failed to send the request: " << strerror(errno) << endl;
+			return false;
+		}
+
+		sent += count;
+	}
+
+	char received[4096];
+	while(1) {
+		size_t newline;
+		while((newline = buffer->find('\n')) != string::npos) {
+			string line = buffer->substr(0, newline);
+			buffer->erase(0, newline + 1);
+			std::cout << line << endl;
+
+			::finance::JsonValue response;
+			string error;
+			if(!::finance::JsonValue::Parse(line, &response, &error)) {
+				std::cerr << "Invalid response: " << error << endl;
+				return false;
+			}
+
+			if(response.HasMember("done")) {
+				return !response.HasMember("error");
+			}
+		}
+
+		ssize_t count = recv(socket_fd, received, sizeof(received), 0);
+		if(count <= 0) {
+			std::cerr << "Connection closed by the daemon." << endl;
+			return false;
+		}
+
+		buffer->append(received, count);
+	}
+}
+
+/*
+ * Command line client of BacktestDaemon.
+ *
+ * Usage: BacktestClient [--socket <path>] [request]
+ *
+ * Sends the request, or every line read from the standard input if there is none, and prints
+ * the results, one JSON line per backtest. For example:
+ *   BacktestClient '{"type": "sweep", "parameter": "exit_gain_criteria.gain_percentage", "values": [0.04, 0.05]}'
+ */
+int main(int argc, char* argv[]) {
+	string socket_path = kDefaultSocketPath;
+	vector<string> requests;
+	for(int i=1; i<argc; i++) {
+		string arg = argv[i];
+		if(arg == "--socket" && i+1 < argc) {
+			socket_path = argv[++i];
+		} else if(arg.size() > 0 && arg[0] == '{') {
+			requests.push_back(arg);
+		} else {
+			std::cerr << "Usage: " << argv[0] << " [--socket <path>] [request]" << endl;
+			return 1;
+		}
+	}
+
+	if(requests.empty()) {
+		string line;
+		while(getline(std::cin, line)) {
+			if(line.find_first_not_of(" \t\r") != string::npos) {
+				requests.push_back(line);
+			}
+		}
+	}
+
+	int socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+	if(socket_fd < 0 || connect(socket_fd, (sockaddr*) &address, sizeof(address)) < 0) {
+		std::cerr << "Failed to connect to " << socket_path << ": " << strerror(errno) << endl;
+		return 1;
+	}
+
+	bool success = true;
+	string buffer;
+	for(const string& request: requests) {
+		if(!SendRequest(socket_fd, request, &buffer)) {
+			success = false;
+		}
+	}
+
+	close(socket_fd);
+	return success ? 0 : 1;
+}
\ No newline at end of file
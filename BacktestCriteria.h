@@ -86,6 +86,28 @@ public:
 };
 
 
+/*
+ * This criteria ranks the buy signals of a day against each other and only buys the best ones,
+ * instead of buying in the order the stocks were loaded. The positions closing on the day are
+ * sold before buying, so that their capital is available to the ranked entries.
+ *
+ * BODY: rank by the body of the candle.
+ * VOLUME_RATIO: rank by the volume over the average volume.
+ * MOMENTUM: rank by the gain of the close over momentum_days candles of the stock.
+ * max_entries: number of best ranked signals offered capital per day.
+ */
+class RankingCriteria: public BaseBacktestCriteria {
+public:
+	enum Score {
+		BODY, VOLUME_RATIO, MOMENTUM
+	};
+
+	Score score;
+	int max_entries;
+	int momentum_days;
+};
+
+
 /*
  * NOTE:
  *	1. Number of days for buy volume criteria and sell volume criteria should be equal.
@@ -102,6 +124,7 @@ public:
 	VolumeCriteria buy_volume_criteria;
 	VolumeCriteria sell_volume_criteria;
 	RiskCriteria risk_criteria;
+	RankingCriteria ranking_criteria;
 };
 }
 
@@ -0,0 +1,192 @@
+#ifndef BACKTEST_CRITERIA_JSON_H
+#define BACKTEST_CRITERIA_JSON_H
+
+#include <iostream>
+#include <climits>
+#include <cmath>
+
+#include "BacktestCriteria.h"
+#include "Json.h"
+
+using namespace std;
+
+namespace finance {
+
+bool GetJsonNumber(const JsonValue& value, const string& field, double* number, string* error) {
+	if(value.type != JsonValue::NUMBER) {
+		*error = field + " should be a number";
+		return false;
+	}
+
+	*number = value.number;
+	return true;
+}
+
+/*
+ * Reads an integer, the number should be finite, without a fractional part and in the range of int.
+ *
+ * minimum: smallest accepted value.
+ */
+bool GetJsonInteger(const JsonValue& value, const string& field, int minimum, int* integer, string* error) {
+	if(value.type != JsonValue::NUMBER || !std::isfinite(value.number) || std::floor(value.number) != value.number ||
+		value.number < minimum || value.number > INT_MAX) {
+		*error = field + " should be an integer";
+		if(minimum > INT_MIN) {
+			*error += " of at least " + to_string(minimum);
+		}
+		return false;
+	}
+
+	*integer = (int) value.number;
+	return true;
+}
+
+bool GetJsonBoolean(const JsonValue& value, const string& field, bool* boolean, string* error) {
+	if(value.type != JsonValue::BOOLEAN) {
+		*error = field + " should be a boolean";
+		return false;
+	}
+
+	*boolean = value.boolean;
+	return true;
+}
+
+/*
+ * Sets a single field of the criteria from its JSON value.
+ *
+ * field: "<criteria>.<field>", e.g. "exit_gain_criteria.gain_percentage" or "risk_criteria.enabled".
+ * returns bool: true if the field exists and the value has the right type, error is set otherwise.
+ */
+bool SetBacktestCriteriaField(const string& field, const JsonValue& value, BacktestCriteria* criteria, string* error) {
+	size_t dot = field.find('.');
+	if(dot == string::npos) {
+		*error = "unknown criteria field " + field;
+		return false;
+	}
+
+	string name = field.substr(0, dot);
+	string member = field.substr(dot + 1);
+
+	BaseBacktestCriteria* base_criteria = nullptr;
+	if(name == "buy_criteria") {
+		base_criteria = &criteria->buy_criteria;
+		if(member == "criteria") {
+			if(value.text == "CLOSE") {
+				criteria->buy_criteria.criteria = BuyCriteria::CLOSE;
+			} else if(value.text == "HIGH") {
+				criteria->buy_criteria.criteria = BuyCriteria::HIGH;
+			} else if(value.text == "MEAN_CLOSE_HIGH") {
+				criteria->buy_criteria.criteria = BuyCriteria::MEAN_CLOSE_HIGH;
+			} else {
+				*error = field + " should be one of CLOSE, HIGH, MEAN_CLOSE_HIGH";
+				return false;
+			}
+
+			return true;
+		}
+	} else if(name == "marubozu_criteria") {
+		base_criteria = &criteria->marubozu_criteria;
+		if(member == "body_minimum_threshold") {
+			return GetJsonNumber(value, field, &criteria->marubozu_criteria.body_minimum_threshold, error);
+		} else if(member == "body_maximum_threshold") {
+			return GetJsonNumber(value, field, &criteria->marubozu_criteria.body_maximum_threshold, error);
+		} else if(member == "lower_shadow_threshold") {
+			return GetJsonNumber(value, field, &criteria->marubozu_criteria.lower_shadow_threshold, error);
+		} else if(member == "upper_shadow_threshold") {
+			return GetJsonNumber(value, field, &criteria->marubozu_criteria.upper_shadow_threshold, error);
+		}
+	} else if(name == "stop_loss_criteria") {
+		base_criteria = &criteria->stop_loss_criteria;
+		if(member == "type") {
+			if(value.text == "LOW") {
+				criteria->stop_loss_criteria.type = StoplossCriteria::LOW;
+			} else if(value.text == "CLOSE") {
+				criteria->stop_loss_criteria.type = StoplossCriteria::CLOSE;
+			} else {
+				*error = field + " should be one of LOW, CLOSE";
+				return false;
+			}
+
+			return true;
+		}
+	} else if(name == "exit_gain_criteria") {
+		base_criteria = &criteria->exit_gain_criteria;
+		if(member == "gain_percentage") {
+			return GetJsonNumber(value, field, &criteria->exit_gain_criteria.gain_percentage, error);
+		}
+	} else if(name == "buy_volume_criteria" || name == "sell_volume_criteria") {
+		VolumeCriteria* volume_criteria = (name == "buy_volume_criteria") ?
+			&criteria->buy_volume_criteria : &criteria->sell_volume_criteria;
+		base_criteria = volume_criteria;
+		if(member == "num_days") {
+			return GetJsonInteger(value, field, 1, &volume_criteria->num_days, error);
+		} else if(member == "average_volume_threshold") {
+			return GetJsonNumber(value, field, &volume_criteria->average_volume_threshold, error);
+		}
+	} else if(name == "ranking_criteria") {
+		base_criteria = &criteria->ranking_criteria;
+		if(member == "score") {
+			if(value.text == "BODY") {
+				criteria->ranking_criteria.score = RankingCriteria::BODY;
+			} else if(value.text == "VOLUME_RATIO") {
+				criteria->ranking_criteria.score = RankingCriteria::VOLUME_RATIO;
+			} else if(value.text == "MOMENTUM") {
+				criteria->ranking_criteria.score = RankingCriteria::MOMENTUM;
+			} else {
+				*error = field + " should be one of BODY, VOLUME_RATIO, MOMENTUM";
+				return false;
+			}
+
+			return true;
+		} else if(member == "max_entries") {
+			/* Not positive means all the signals. */
+			return GetJsonInteger(value, field, INT_MIN, &criteria->ranking_criteria.max_entries, error);
+		} else if(member == "momentum_days") {
+			return GetJsonInteger(value, field, 1, &criteria->ranking_criteria.momentum_days, error);
+		}
+	} else if(name == "risk_criteria") {
+		base_criteria = &criteria->risk_criteria;
+		if(member == "risk_percentage") {
+			return GetJsonNumber(value, field, &criteria->risk_criteria.risk_percentage, error);
+		}
+	}
+
+	if(base_criteria != nullptr && member == "enabled") {
+		return GetJsonBoolean(value, field, &base_criteria->enabled, error);
+	}
+
+	*error = "unknown criteria field " + field;
+	return false;
+}
+
+/*
+ * Overrides the criteria with the fields present in the JSON, which has the same layout as
+ * BacktestCriteria, e.g. {"exit_gain_criteria": {"enabled": true, "gain_percentage": 0.1}}.
+ *
+ * returns bool: true if all the fields were set, error is set otherwise.
+ */
+bool ApplyBacktestCriteriaJson(const JsonValue& json, BacktestCriteria* criteria, string* error) {
+	if(!json.IsObject()) {
+		*error = "criteria should be an object";
+		return false;
+	}
+
+	for(auto it = json.members.begin(); it != json.members.end(); it++) {
+		if(!it->second.IsObject()) {
+			*error = it->first + " should be an object";
+			return false;
+		}
+
+		for(auto member = it->second.members.begin(); member != it->second.members.end(); member++) {
+			if(!SetBacktestCriteriaField(it->first + "." + member->first, member->second, criteria, error)) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+}
+
+#endif
\ No newline at end of file
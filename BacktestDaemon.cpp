@@ -0,0 +1,406 @@
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <future>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "Backtest.h"
+#include "BacktestCriteriaJson.h"
+#include "Json.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+const string kDefaultSocketPath = "/tmp/finance-backtest.sock";
+
+/* Maximum size of a request line, the connection is closed if a client sends more without a newline. */
+const size_t kMaxRequestSize = 1 << 20;
+
+/*
+ * Writes the line to the socket.
+ *
+ * returns bool: false if the client has gone away.
+ */
+bool SendLine(int socket_fd, const string& line) {
+	string data = line + "\n";
+	size_t sent = 0;
+	while(sent < data.size()) {
+		ssize_t count = send(socket_fd, data.c_str() + sent, data.size() - sent, MSG_NOSIGNAL);
+		if(count <= 0) {
+			return false;
+		}
+
+		sent += count;
+	}
+
+	return true;
+}
+
+string GetErrorLine(const string& error) {
+	return "{\"done\": true, \"error\": " + ::finance::JsonValue::Quote(error) + "}";
+}
+
+long long GetElapsedMilliseconds(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+ * Serves the backtest requests on the candles loaded once at startup.
+ *
+ * Every request is a single line of JSON:
+ *   {"type": "backtest", "criteria": {...}, "start_time": "6/22/2008 15:30:00", "capital": 100000}
+ *   {"type": "sweep", "criteria": {...}, "parameter": "exit_gain_criteria.gain_percentage", "values": [0.04, 0.05]}
+ * criteria, start_time and capital are optional and override the defaults, see ApplyBacktestCriteriaJson.
+ * A sweep runs one backtest per value of the parameter on the thread pool.
+ *
+ * Every result is streamed back as a line of JSON as soon as it is available, in the order of the
+ * backtests, followed by a line with "done" (and "error" if the request failed).
+ */
+template <typename MergedCandles>
+class BacktestServer {
+public:
+	BacktestServer(const MergedCandles& merged_candles, const ::finance::BacktestCriteria& default_criteria,
+		::finance::ThreadPool* thread_pool) : merged_candles(merged_candles), stock_candle_index(merged_candles) {
+		this->default_criteria = default_criteria;
+		this->thread_pool = thread_pool;
+	}
+
+	void HandleConnection(int socket_fd) {
+		string buffer;
+		char data[4096];
+		while(1) {
+			ssize_t count = recv(socket_fd, data, sizeof(data), 0);
+			if(count <= 0) {
+				break;
+			}
+
+			buffer.append(data, count);
+			size_t newline;
+			while((newline = buffer.find('\n')) != string::npos) {
+				string line = buffer.substr(0, newline);
+				buffer.erase(0, newline + 1);
+				if(line.find_first_not_of(" \t\r") == string::npos) {
+					continue;
+				}
+
+				if(!HandleRequest(socket_fd, line)) {
+					close(socket_fd);
+					return;
+				}
+			}
+
+			if(buffer.size() > kMaxRequestSize) {
+				SendLine(socket_fd, GetErrorLine("request longer than " + to_string(kMaxRequestSize) + " bytes"));
+				break;
+			}
+		}
+
+		close(socket_fd);
+	}
+
+private:
+	/*
+	 * Runs the request and streams its results.
+	 *
+	 * returns bool: false if the client has gone away.
+	 */
+	bool HandleRequest(int socket_fd, const string& line) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		::finance::JsonValue request;
+		string error;
+		if(!::finance::JsonValue::Parse(line, &request, &error)) {
+			return SendLine(socket_fd, GetErrorLine("invalid JSON: " + error));
+		}
+
+		::finance::BacktestCriteria criteria = default_criteria;
+		if(request.HasMember("criteria") &&
+			!::finance::ApplyBacktestCriteriaJson(request.GetMember("criteria"), &criteria, &error)) {
+			return SendLine(socket_fd, GetErrorLine(error));
+		}
+
+		string start_time = ::finance::constants::kBacktestStartTime;
+		if(request.HasMember("start_time")) {
+			if(request.GetMember("start_time").type != ::finance::JsonValue::STRING) {
+				return SendLine(socket_fd, GetErrorLine("start_time should be a string"));
+			}
+
+			start_time = request.GetMember("start_time").text;
+			tm start_time_struct = tm();
+			const char* end = strptime(start_time.c_str(), ::finance::kGoogleFinanceDateTimeFormat.c_str(), &start_time_struct);
+			if(end == nullptr || *end != '\0') {
+				return SendLine(socket_fd, GetErrorLine("start_time should be formatted as " + 
+					::finance::kGoogleFinanceDateTimeFormat + ", e.g. " + ::finance::constants::kBacktestStartTime));
+			}
+		}
+
+		double capital = ::finance::constants::kInitialCapital;
+		if(request.HasMember("capital")) {
+			if(!::finance::GetJsonNumber(request.GetMember("capital"), "capital", &capital, &error)) {
+				return SendLine(socket_fd, GetErrorLine(error));
+			}
+
+			if(!std::isfinite(capital) || capital <= 0) {
+				return SendLine(socket_fd, GetErrorLine("capital should be positive"));
+			}
+		}
+
+		/* Building the criteria of every backtest of the request. */
+		vector< ::finance::BacktestCriteria> criterias;
+		string type = request.GetMember("type").text;
+		if(type == "backtest") {
+			criterias.push_back(criteria);
+		} else if(type == "sweep") {
+			string parameter = request.GetMember("parameter").text;
+			const ::finance::JsonValue& values = request.GetMember("values");
+			if(values.type != ::finance::JsonValue::ARRAY) {
+				return SendLine(socket_fd, GetErrorLine("values should be an array"));
+			}
+
+			for(const ::finance::JsonValue& value: values.elements) {
+				criterias.push_back(criteria);
+				if(!::finance::SetBacktestCriteriaField(parameter, value, &criterias.back(), &error)) {
+					return SendLine(socket_fd, GetErrorLine(error));
+				}
+			}
+		} else {
+			return SendLine(socket_fd, GetErrorLine("type should be one of backtest, sweep"));
+		}
+
+		/* The average volumes are computed when loading the candles, so the number of days is fixed. */
+		for(const ::finance::BacktestCriteria& backtest_criteria: criterias) {
+			if(backtest_criteria.buy_volume_criteria.num_days != default_criteria.buy_volume_criteria.num_days) {
+				return SendLine(socket_fd, GetErrorLine("buy_volume_criteria.num_days should be " +
+					to_string(default_criteria.buy_volume_criteria.num_days) + ", the candles were loaded with it"));
+			}
+		}
+
+		/* The backtests of a sweep share the buy signals, unless the parameter changes them. */
+		std::shared_ptr< ::finance::SignalIndex> signal_index;
+		if(!criterias.empty()) {
+			signal_index = std::make_shared< ::finance::SignalIndex>(merged_candles, criterias[0]);
+		}
+
+		vector<std::future<BacktestResult> > results;
+		for(const ::finance::BacktestCriteria& backtest_criteria: criterias) {
+			const MergedCandles* candles = &merged_candles;
+			const ::finance::StockCandleIndex* index = &stock_candle_index;
+			results.push_back(thread_pool->Submit([candles, index, signal_index, start_time, capital, backtest_criteria]() {
+				return RunBacktest(*candles, start_time, ::finance::kGoogleFinanceDateTimeFormat,
+					capital, backtest_criteria, "", index, signal_index.get());
+			}));
+		}
+
+		bool connected = true;
+		for(int i=0; i<(int) results.size(); i++) {
+			BacktestResult result = results[i].get();
+			if(!connected) {
+				continue;
+			}
+
+			stringstream output;
+			output << std::setprecision(15);
+			output << "{\"index\": " << i;
+			if(type == "sweep") {
+				output << ", \"value\": " << ValueToJson(request.GetMember("values").elements[i]);
+			}
+			output << ", \"final_capital\": " << result.final_capital
+				<< ", \"wins\": " << result.wins
+				<< ", \"losses\": " << result.losses
+				<< ", \"cagr\": " << result.cagr << "}";
+			connected = SendLine(socket_fd, output.str());
+		}
+
+		if(!connected) {
+			return false;
+		}
+
+		return SendLine(socket_fd, "{\"done\": true, \"num_results\": " + to_string(results.size()) +
+			", \"elapsed_ms\": " + to_string(GetElapsedMilliseconds(start)) + "}");
+	}
+
+	/* Formats a sweep value, which is a number, a boolean or a string. */
+	static string ValueToJson(const ::finance::JsonValue& value) {
+		if(value.type == ::finance::JsonValue::NUMBER) {
+			stringstream output;
+			output << std::setprecision(15) << value.number;
+			return output.str();
+		} else if(value.type == ::finance::JsonValue::BOOLEAN) {
+			return value.boolean ? "true" : "false";
+		}
+
+		return ::finance::JsonValue::Quote(value.text);
+	}
+
+	const MergedCandles& merged_candles;
+	::finance::StockCandleIndex stock_candle_index;
+	::finance::BacktestCriteria default_criteria;
+	::finance::ThreadPool* thread_pool;
+};
+
+/*
+ * Removes the socket left behind by a previous run at the address, if any. Anything else at the
+ * path is left alone, as is the socket of a daemon that is still listening on it.
+ *
+ * returns bool: true if the path is free to bind to.
+ */
+bool RemoveStaleSocket(const sockaddr_un& address) {
+	struct stat status;
+	if(lstat(address.sun_path, &status) < 0) {
+		if(errno == ENOENT) {
+			return true;
+		}
+
+		std::cout << "Failed to check " << address.sun_path << ": " << strerror(errno) << endl;
+		return false;
+	}
+
+	if(!S_ISSOCK(status.st_mode)) {
+		std::cout << address.sun_path << " exists and is not a socket, not replacing it." << endl;
+		return false;
+	}
+
+	int socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(socket_fd < 0) {
+		std::cout << "Failed to create socket: " << strerror(errno) << endl;
+		return false;
+	}
+
+	bool listening = (connect(socket_fd, (const sockaddr*) &address, sizeof(address)) == 0);
+	close(socket_fd);
+	if(listening) {
+		std::cout << "Another daemon is listening on " << address.sun_path << "." << endl;
+		return false;
+	}
+
+	if(unlink(address.sun_path) < 0) {
+		std::cout << "Failed to remove " << address.sun_path << ": " << strerror(errno) << endl;
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Binds and listens on the socket. Done before loading the candles, so that a daemon that cannot
+ * get the socket fails right away; the connections made while loading wait in the backlog.
+ *
+ * returns int: the socket, -1 if it could not be set up.
+ */
+int Listen(const string& socket_path) {
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(socket_path.size() >= sizeof(address.sun_path)) {
+		std::cout << "Socket path too long: " << socket_path << endl;
+		return -1;
+	}
+	strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+	if(!RemoveStaleSocket(address)) {
+		return -1;
+	}
+
+	int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(server_fd < 0) {
+		std::cout << "Failed to create socket: " << strerror(errno) << endl;
+		return -1;
+	}
+
+	if(bind(server_fd, (sockaddr*) &address, sizeof(address)) < 0 || listen(server_fd, 16) < 0) {
+		std::cout << "Failed to listen on " << socket_path << ": " << strerror(errno) << endl;
+		close(server_fd);
+		return -1;
+	}
+
+	return server_fd;
+}
+
+/*
+ * Serves every connection of the listening socket on its own thread, the backtests themselves
+ * run on the shared thread pool. Never returns: the connection threads are detached and use the
+ * server and the thread pool, so these live until the process exits.
+ */
+template <typename MergedCandles>
+[[noreturn]] void Serve(const MergedCandles& merged_candles, const ::finance::BacktestCriteria& criteria,
+	int server_fd, int num_threads) {
+	::finance::ThreadPool thread_pool(num_threads);
+	BacktestServer<MergedCandles> server(merged_candles, criteria, &thread_pool);
+
+	std::cout << "Serving with " << thread_pool.GetNumThreads() << " threads." << endl;
+	while(1) {
+		int client_fd = accept(server_fd, nullptr, nullptr);
+		if(client_fd < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			/* Running out of file descriptors or memory is temporary, the daemon keeps serving once freed. */
+			std::cout << "Failed to accept connection: " << strerror(errno) << endl;
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+			continue;
+		}
+
+		std::thread(&BacktestServer<MergedCandles>::HandleConnection, &server, client_fd).detach();
+	}
+}
+
+/*
+ * Resident backtest service, keeps the candles of the universe in memory and serves backtest
+ * requests over a Unix domain socket. Use BacktestClient to send requests.
+ *
+ * Usage: BacktestDaemon [--socket <path>] [--threads <n>] [--compact]
+ *
+ * --socket: path of the socket, /tmp/finance-backtest.sock by default.
+ * --threads: number of backtests run in parallel, the number of hardware threads by default.
+ * --compact: keeps the candles in the compact representation, unless some prices are not exact in ticks.
+ */
+int main(int argc, char* argv[]) {
+	string socket_path = kDefaultSocketPath;
+	int num_threads = 0;
+	bool use_compact_candles = false;
+	for(int i=1; i<argc; i++) {
+		string arg = argv[i];
+		if(arg == "--socket" && i+1 < argc) {
+			socket_path = argv[++i];
+		} else if(arg == "--threads" && i+1 < argc) {
+			num_threads = atoi(argv[++i]);
+		} else if(arg == "--compact") {
+			use_compact_candles = true;
+		} else {
+			std::cout << "Usage: " << argv[0] << " [--socket <path>] [--threads <n>] [--compact]" << endl;
+			return 1;
+		}
+	}
+
+	int server_fd = Listen(socket_path);
+	if(server_fd < 0) {
+		return 1;
+	}
+	std::cout << "Listening on " << socket_path << "." << endl;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	::finance::BacktestCriteria criteria = GetDefaultBacktestCriteria();
+
+	if(use_compact_candles) {
+		std::vector< ::finance::CompactStockCandles> multiple_stock_candles = GetMultipleCompactStockCandles(criteria);
+		if(::finance::AreCompactStockCandlesExact(multiple_stock_candles)) {
+			::finance::CompactMergedCandles merged_candles(multiple_stock_candles);
+			std::cout << "Loaded " << merged_candles.size() << " timestamps in " << GetElapsedMilliseconds(start) << " ms." << endl;
+			Serve(merged_candles, criteria, server_fd, num_threads);
+		}
+
+		/* Rounding the prices to ticks would change the trades. */
+		std::cout << "Falling back to the double precision candles." << endl;
+	}
+
+	vector<StockCandlesForTimestamp> merged_candles = MergeStockCandles(GetMultipleStockCandles(criteria));
+	std::cout << "Loaded " << merged_candles.size() << " timestamps in " << GetElapsedMilliseconds(start) << " ms." << endl;
+	Serve(merged_candles, criteria, server_fd, num_threads);
+}
\ No newline at end of file
@@ -0,0 +1,200 @@
+#ifndef CANDLE_INDEX_H
+#define CANDLE_INDEX_H
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "BacktestCriteria.h"
+#include "CompactStockCandle.h"
+#include "StockCandle.h"
+#include "TradeState.h"
+
+using namespace std;
+
+namespace finance {
+
+/*
+ * Access to a single candle of the merged candles, by timestamp index and position within the
+ * timestamp, without materializing the other candles of the timestamp.
+ */
+int GetNumCandles(const vector<pair<tm, vector<StockCandle> > >& merged_candles, int index) {
+	return merged_candles[index].second.size();
+}
+
+const StockCandle& GetCandle(const vector<pair<tm, vector<StockCandle> > >& merged_candles, int index, int position) {
+	return merged_candles[index].second[position];
+}
+
+int GetNumCandles(const CompactMergedCandles& merged_candles, int index) {
+	return merged_candles.GetNumCandles(index);
+}
+
+StockCandle GetCandle(const CompactMergedCandles& merged_candles, int index, int position) {
+	return merged_candles.GetStockCandle(index, position);
+}
+
+tm GetTimestamp(const vector<pair<tm, vector<StockCandle> > >& merged_candles, int index) {
+	return merged_candles[index].first;
+}
+
+tm GetTimestamp(const CompactMergedCandles& merged_candles, int index) {
+	return merged_candles.GetTimestamp(index);
+}
+
+time_t GetTime(const vector<pair<tm, vector<StockCandle> > >& merged_candles, int index) {
+	tm timestamp = merged_candles[index].first;
+	return mktime(&timestamp);
+}
+
+time_t GetTime(const CompactMergedCandles& merged_candles, int index) {
+	return merged_candles.GetTime(index);
+}
+
+/*
+ * Position of a candle in the merged candles.
+ */
+struct CandlePosition {
+	int index;
+	int position;
+};
+
+/*
+ * Index of the candles of every stock in the merged candles, so that the candle of a stock at a
+ * timestamp can be found without going through the other candles of the timestamp.
+ * Only depends on the candles, it can be shared by all the backtests on them.
+ */
+class StockCandleIndex {
+public:
+	template <typename MergedCandles>
+	StockCandleIndex(const MergedCandles& merged_candles) {
+		/* Going from the oldest timestamp, the order in which the backtest processes the candles. */
+		timestamp_offsets.resize(merged_candles.size());
+		for(int index=merged_candles.size() - 1; index>=0; index--) {
+			timestamp_offsets[index] = stock_ids.size();
+			int num_candles = GetNumCandles(merged_candles, index);
+			for(int position=0; position<num_candles; position++) {
+				const StockCandle& candle = GetCandle(merged_candles, index, position);
+				auto it = symbol_stock_ids.find(candle.symbol);
+				if(it == symbol_stock_ids.end()) {
+					it = symbol_stock_ids.insert(std::make_pair(candle.symbol, (int) symbols.size())).first;
+					symbols.push_back(candle.symbol);
+					stock_candle_positions.push_back(vector<CandlePosition>());
+				}
+
+				CandlePosition candle_position;
+				candle_position.index = index;
+				candle_position.position = position;
+				stock_candle_positions[it->second].push_back(candle_position);
+				stock_ids.push_back(it->second);
+			}
+		}
+	}
+
+	int GetNumStocks() const {
+		return symbols.size();
+	}
+
+	/* Returns the id of the stock, -1 if it has no candles. */
+	int GetStockId(const string& symbol) const {
+		auto it = symbol_stock_ids.find(symbol);
+		if(it == symbol_stock_ids.end()) {
+			return -1;
+		}
+
+		return it->second;
+	}
+
+	/* Returns the id of the stock of the candle at the position of the timestamp. */
+	int GetStockId(int index, int position) const {
+		return stock_ids[timestamp_offsets[index] + position];
+	}
+
+	/* Returns the positions of the candles of the stock, oldest timestamp first. */
+	const vector<CandlePosition>& GetCandlePositions(int stock_id) const {
+		return stock_candle_positions[stock_id];
+	}
+
+	/*
+	 * Returns the first candle of the stock at the timestamp or after it, i.e. the next candle
+	 * processed by a backtest at that timestamp. The size of GetCandlePositions if there is none.
+	 */
+	int GetNextCandle(int stock_id, int index) const {
+		const vector<CandlePosition>& positions = stock_candle_positions[stock_id];
+		return std::lower_bound(positions.begin(), positions.end(), index,
+			[](const CandlePosition& candle_position, int index) {
+				return candle_position.index > index;
+			}) - positions.begin();
+	}
+
+private:
+	map<string, int> symbol_stock_ids;
+	vector<string> symbols;
+	vector<vector<CandlePosition> > stock_candle_positions;
+
+	/* Stock ids of the candles, oldest timestamp first, and where the candles of every timestamp start. */
+	vector<int> stock_ids;
+	vector<int> timestamp_offsets;
+};
+
+/*
+ * Index of the buy signals (TradeState::IsBuySignal) for every timestamp of the merged candles.
+ * Only depends on the candles and on the buy signal criteria, so it can be shared by backtests
+ * that differ in the other criteria, e.g. a sweep over the exit gain.
+ */
+class SignalIndex {
+public:
+	template <typename MergedCandles>
+	SignalIndex(const MergedCandles& merged_candles, const BacktestCriteria& criteria) {
+		this->criteria = criteria;
+		signal_positions.resize(merged_candles.size());
+		for(int index=0; index<(int) merged_candles.size(); index++) {
+			int num_candles = GetNumCandles(merged_candles, index);
+			for(int position=0; position<num_candles; position++) {
+				if(TradeState::IsBuySignal(GetCandle(merged_candles, index, position), criteria)) {
+					signal_positions[index].push_back(position);
+				}
+			}
+		}
+	}
+
+	/* Checks if the signals are the same for the criteria as for the one the index was built with. */
+	bool IsCompatible(const BacktestCriteria& other_criteria) const {
+		const MarubozuCriteria& marubozu_criteria = criteria.marubozu_criteria;
+		const MarubozuCriteria& other_marubozu_criteria = other_criteria.marubozu_criteria;
+		if(marubozu_criteria.enabled != other_marubozu_criteria.enabled) {
+			return false;
+		}
+
+		if(marubozu_criteria.enabled &&
+			(marubozu_criteria.body_minimum_threshold != other_marubozu_criteria.body_minimum_threshold ||
+			marubozu_criteria.body_maximum_threshold != other_marubozu_criteria.body_maximum_threshold ||
+			marubozu_criteria.lower_shadow_threshold != other_marubozu_criteria.lower_shadow_threshold ||
+			marubozu_criteria.upper_shadow_threshold != other_marubozu_criteria.upper_shadow_threshold)) {
+			return false;
+		}
+
+		const VolumeCriteria& volume_criteria = criteria.buy_volume_criteria;
+		const VolumeCriteria& other_volume_criteria = other_criteria.buy_volume_criteria;
+		if(volume_criteria.enabled != other_volume_criteria.enabled) {
+			return false;
+		}
+
+		return (!volume_criteria.enabled ||
+			volume_criteria.average_volume_threshold == other_volume_criteria.average_volume_threshold);
+	}
+
+	/* Returns the positions of the buy signals in the timestamp, in increasing order. */
+	const vector<int>& GetSignalPositions(int index) const {
+		return signal_positions[index];
+	}
+
+private:
+	BacktestCriteria criteria;
+	vector<vector<int> > signal_positions;
+};
+
+}
+
+#endif
\ No newline at end of file
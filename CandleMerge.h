@@ -0,0 +1,66 @@
+#ifndef CANDLE_MERGE_H
+#define CANDLE_MERGE_H
+
+#include <iostream>
+#include <vector>
+#include <ctime>
+#include <algorithm>
+
+using namespace std;
+
+namespace finance {
+
+/*
+ * Merges the candles of multiple stocks into timestamps by their close time. Shared by the double
+ * precision and the compact candles, so that both are merged into exactly the same timestamps.
+ *
+ * multiple_close_times: the close times of the candles of every stock, latest candle first.
+ * returns: the close time of every timestamp, latest first, with the (stock index, candle index)
+ * of its candles in the order of the stocks.
+ */
+vector<pair<time_t, vector<pair<int, int> > > > MergeCloseTimes(const vector<vector<time_t> >& multiple_close_times) {
+	vector<pair<time_t, vector<pair<int, int> > > > merged_close_times;
+
+	vector<int> indexes;
+	for(const vector<time_t>& close_times: multiple_close_times) {
+		indexes.push_back(close_times.size() - 1);
+	}
+
+	while(1) {
+		int start_index = -1;
+		for(int i=0; i<(int) indexes.size(); i++) {
+			if(indexes[i] >= 0) {
+				start_index = i;
+				break;
+			}
+		}
+
+		if(start_index == -1) {
+			break;
+		}
+
+		time_t minimum_time = multiple_close_times[start_index][indexes[start_index]];
+		for(int i=start_index; i<(int) indexes.size(); i++) {
+			if(indexes[i] >= 0 && multiple_close_times[i][indexes[i]] < minimum_time) {
+				minimum_time = multiple_close_times[i][indexes[i]];
+			}
+		}
+
+		vector<pair<int, int> > candle_indexes;
+		for(int i=start_index; i<(int) indexes.size(); i++) {
+			if(indexes[i] >= 0 && multiple_close_times[i][indexes[i]] == minimum_time) {
+				candle_indexes.push_back(std::make_pair(i, indexes[i]));
+				indexes[i]--;
+			}
+		}
+
+		merged_close_times.push_back(std::make_pair(minimum_time, candle_indexes));
+	}
+
+	std::reverse(merged_close_times.begin(), merged_close_times.end());
+	return merged_close_times;
+}
+
+}
+
+#endif
@@ -0,0 +1,269 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+#include "BacktestCriteria.h"
+#include "CandleIndex.h"
+#include "CompactStockCandle.h"
+#include "StockCandle.h"
+#include "TradeState.h"
+
+using namespace std;
+
+namespace finance {
+
+const string kCheckpointHeader = "finance-backtest-checkpoint 2";
+
+/*
+ * 64 bit FNV-1a hash, used to detect changes in the inputs of a checkpointed backtest.
+ */
+class Fingerprint {
+public:
+	Fingerprint() {
+		value = 14695981039346656037ULL;
+	}
+
+	void Add(const void* data, size_t size) {
+		const unsigned char* bytes = (const unsigned char*) data;
+		for(size_t i=0; i<size; i++) {
+			value ^= bytes[i];
+			value *= 1099511628211ULL;
+		}
+	}
+
+	void Add(double number) {
+		Add(&number, sizeof(number));
+	}
+
+	void Add(int64_t number) {
+		Add(&number, sizeof(number));
+	}
+
+	void Add(const string& text) {
+		Add((int64_t) text.size());
+		Add(text.data(), text.size());
+	}
+
+	/*
+	 * Adds the fields read from the data, the derived fields are computed from these. The close
+	 * time is the one of the timestamp of the merged candles, it is added once for all its candles.
+	 */
+	void AddCandle(const string& symbol, double open, double high, double low, double close, double volume) {
+		Add(symbol);
+		Add(open);
+		Add(high);
+		Add(low);
+		Add(close);
+		Add(volume);
+	}
+
+	uint64_t value;
+};
+
+void AddCandle(const vector<pair<tm, vector<StockCandle> > >& merged_candles, int index, int position,
+	Fingerprint* fingerprint) {
+	const StockCandle& candle = merged_candles[index].second[position];
+	fingerprint->AddCandle(candle.symbol, candle.open, candle.high, candle.low, candle.close, candle.volume);
+}
+
+/* The prices are exact in ticks, so this adds the same values as for the double precision candles. */
+void AddCandle(const CompactMergedCandles& merged_candles, int index, int position, Fingerprint* fingerprint) {
+	int candle_index;
+	const CompactStockCandles& candles = merged_candles.GetStockCandles(index, position, &candle_index);
+	fingerprint->AddCandle(candles.symbol, candles.GetOpen(candle_index), candles.GetHigh(candle_index),
+		candles.GetLow(candle_index), candles.GetClose(candle_index), candles.GetVolume(candle_index));
+}
+
+/*
+ * Fingerprints of every prefix of the merged candles, oldest timestamp first. The input of a
+ * checkpoint is checked against these, so the candles are only hashed once, when loading them.
+ * Only depends on the candles, it can be shared by all the backtests on them.
+ */
+class InputFingerprints {
+public:
+	template <typename MergedCandles>
+	InputFingerprints(const MergedCandles& merged_candles) {
+		Fingerprint fingerprint;
+		prefix_fingerprints.push_back(fingerprint.value);
+		for(int index=merged_candles.size() - 1; index>=0; index--) {
+			int num_candles = GetNumCandles(merged_candles, index);
+			fingerprint.Add((int64_t) GetTime(merged_candles, index));
+			fingerprint.Add((int64_t) num_candles);
+			for(int position=0; position<num_candles; position++) {
+				AddCandle(merged_candles, index, position, &fingerprint);
+			}
+			prefix_fingerprints.push_back(fingerprint.value);
+		}
+	}
+
+	int GetNumTimestamps() const {
+		return prefix_fingerprints.size() - 1;
+	}
+
+	/* Returns the fingerprint of the oldest num_timestamps timestamps. */
+	uint64_t GetFingerprint(int num_timestamps) const {
+		return prefix_fingerprints[num_timestamps];
+	}
+
+private:
+	vector<uint64_t> prefix_fingerprints;
+};
+
+/*
+ * Returns the fingerprint of the criteria, only the fields of the enabled criterias are used
+ * since the others do not affect the backtest.
+ */
+uint64_t GetCriteriaFingerprint(const BacktestCriteria& criteria) {
+	Fingerprint fingerprint;
+
+	fingerprint.Add((int64_t) criteria.buy_criteria.enabled);
+	if(criteria.buy_criteria.enabled) {
+		fingerprint.Add((int64_t) criteria.buy_criteria.criteria);
+	}
+
+	fingerprint.Add((int64_t) criteria.marubozu_criteria.enabled);
+	if(criteria.marubozu_criteria.enabled) {
+		fingerprint.Add(criteria.marubozu_criteria.body_minimum_threshold);
+		fingerprint.Add(criteria.marubozu_criteria.body_maximum_threshold);
+		fingerprint.Add(criteria.marubozu_criteria.lower_shadow_threshold);
+		fingerprint.Add(criteria.marubozu_criteria.upper_shadow_threshold);
+	}
+
+	fingerprint.Add((int64_t) criteria.stop_loss_criteria.enabled);
+	if(criteria.stop_loss_criteria.enabled) {
+		fingerprint.Add((int64_t) criteria.stop_loss_criteria.type);
+	}
+
+	fingerprint.Add((int64_t) criteria.exit_gain_criteria.enabled);
+	if(criteria.exit_gain_criteria.enabled) {
+		fingerprint.Add(criteria.exit_gain_criteria.gain_percentage);
+	}
+
+	fingerprint.Add((int64_t) criteria.buy_volume_criteria.enabled);
+	if(criteria.buy_volume_criteria.enabled) {
+		fingerprint.Add((int64_t) criteria.buy_volume_criteria.num_days);
+		fingerprint.Add(criteria.buy_volume_criteria.average_volume_threshold);
+	}
+
+	fingerprint.Add((int64_t) criteria.sell_volume_criteria.enabled);
+	if(criteria.sell_volume_criteria.enabled) {
+		fingerprint.Add((int64_t) criteria.sell_volume_criteria.num_days);
+		fingerprint.Add(criteria.sell_volume_criteria.average_volume_threshold);
+	}
+
+	fingerprint.Add((int64_t) criteria.risk_criteria.enabled);
+	if(criteria.risk_criteria.enabled) {
+		fingerprint.Add(criteria.risk_criteria.risk_percentage);
+	}
+
+	fingerprint.Add((int64_t) criteria.ranking_criteria.enabled);
+	if(criteria.ranking_criteria.enabled) {
+		fingerprint.Add((int64_t) criteria.ranking_criteria.score);
+		fingerprint.Add((int64_t) criteria.ranking_criteria.max_entries);
+		fingerprint.Add((int64_t) criteria.ranking_criteria.momentum_days);
+	}
+
+	return fingerprint.value;
+}
+
+/*
+ * Snapshot of a backtest after processing the oldest num_timestamps merged timestamps.
+ *
+ * input_fingerprint: fingerprint of the candles of the processed timestamps. A backtest can only
+ * be resumed if the same prefix of the input produces the same fingerprint. The rolling windows
+ * (e.g. the average volume) are computed from the input, so they are covered by this check.
+ * capital: capital left before adding back the ongoing trades.
+ */
+class BacktestCheckpoint {
+public:
+	BacktestCheckpoint() {
+		criteria_fingerprint = 0;
+		start_time = 0;
+		initial_capital = 0;
+		num_timestamps = 0;
+		input_fingerprint = 0;
+		capital = 0;
+	}
+
+	/*
+	 * Writes the checkpoint to the file.
+	 *
+	 * returns bool: true if the checkpoint was written successfully.
+	 */
+	bool Save(const string& filename) const {
+		/* Writing to a temporary file first so that a crash never leaves a partial checkpoint. */
+		string temporary_filename = filename + ".tmp";
+		std::ofstream file(temporary_filename);
+		if(!file) {
+			return false;
+		}
+
+		file << std::setprecision(17);
+		file << kCheckpointHeader << endl;
+		file << "criteria_fingerprint " << criteria_fingerprint << endl;
+		file << "start_time " << (long long) start_time << endl;
+		file << "initial_capital " << initial_capital << endl;
+		file << "num_timestamps " << num_timestamps << endl;
+		file << "input_fingerprint " << input_fingerprint << endl;
+		file << "capital " << capital << endl;
+		state.WriteTo(file);
+		file.close();
+
+		if(!file) {
+			return false;
+		}
+
+		return (rename(temporary_filename.c_str(), filename.c_str()) == 0);
+	}
+
+	/*
+	 * Reads the checkpoint from the file.
+	 *
+	 * returns bool: true if the file exists and is a valid checkpoint.
+	 */
+	bool Load(const string& filename) {
+		std::ifstream file(filename);
+		if(!file) {
+			return false;
+		}
+
+		string header;
+		getline(file, header);
+		if(header != kCheckpointHeader) {
+			return false;
+		}
+
+		long long start_time_value;
+		string key;
+		if(!(file >> key >> criteria_fingerprint) || key != "criteria_fingerprint" ||
+			!(file >> key >> start_time_value) || key != "start_time" ||
+			!(file >> key >> initial_capital) || key != "initial_capital" ||
+			!(file >> key >> num_timestamps) || key != "num_timestamps" ||
+			!(file >> key >> input_fingerprint) || key != "input_fingerprint" ||
+			!(file >> key >> capital) || key != "capital") {
+			return false;
+		}
+		start_time = start_time_value;
+
+		return state.ReadFrom(file);
+	}
+
+	uint64_t criteria_fingerprint;
+	time_t start_time;
+	double initial_capital;
+	int num_timestamps;
+	uint64_t input_fingerprint;
+	double capital;
+	TradeState state;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,273 @@
+#ifndef COMPACT_STOCK_CANDLE_H
+#define COMPACT_STOCK_CANDLE_H
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <climits>
+#include <cmath>
+#include <ctime>
+#include <algorithm>
+
+#include "CandleMerge.h"
+#include "StockCandle.h"
+
+using namespace std;
+
+namespace finance {
+
+/* Number of price ticks (paise) in one unit of price (rupee). */
+const int kPriceTicksPerUnit = 100;
+
+/*
+ * Compact, column wise storage of the candles of a single stock.
+ *
+ * Prices are stored as int32 ticks and the volume as int64. The derived fields (colour, body,
+ * shadows and average volume) are not stored, they are computed when a candle is materialized
+ * with GetStockCandle(). The candles are in the same order as returned by GetStockCandles(),
+ * i.e. the latest candle is at index 0.
+ *
+ * exact: true if every price and volume read was exactly representable in ticks, in which case
+ * the materialized candles are bit for bit equal to the ones of the double precision path.
+ */
+class CompactStockCandles {
+public:
+	CompactStockCandles() {
+		average_volume_days = 0;
+		exact = true;
+	}
+
+	int Size() const {
+		return close_times.size();
+	}
+
+	void Append(time_t close_time, int32_t open, int32_t high, int32_t low, int32_t close, int64_t volume) {
+		close_times.push_back(close_time);
+		opens.push_back(open);
+		highs.push_back(high);
+		lows.push_back(low);
+		closes.push_back(close);
+		volumes.push_back(volume);
+	}
+
+	static double TicksToPrice(int32_t ticks) {
+		return ((double) ticks)/kPriceTicksPerUnit;
+	}
+
+	/*
+	 * Converts a price to ticks.
+	 *
+	 * returns bool: true if converting the ticks back gives exactly the same price.
+	 */
+	static bool PriceToTicks(double price, int32_t* ticks) {
+		long long rounded = llround(price*kPriceTicksPerUnit);
+		if(rounded > INT32_MAX || rounded < INT32_MIN) {
+			*ticks = 0;
+			return false;
+		}
+
+		*ticks = rounded;
+		return (TicksToPrice(*ticks) == price);
+	}
+
+	/*
+	 * Computes the average volume over the candle and the (average_volume_days - 1) candles
+	 * preceding it, over fewer candles at the start of the data. This is the same window as
+	 * the one computed in GetStockCandles(), the sum is exact since the volumes are integers.
+	 */
+	double GetAverageVolume(int index) const {
+		int end = std::min(index + average_volume_days, Size());
+		int64_t total_volume = 0;
+		for(int i=index; i<end; i++) {
+			total_volume += volumes[i];
+		}
+
+		return ((double) total_volume)/(end - index);
+	}
+
+	time_t GetCloseTime(int index) const {
+		return close_times[index];
+	}
+
+	const vector<time_t>& GetCloseTimes() const {
+		return close_times;
+	}
+
+	/* The fields read from the data, without materializing the candle. */
+	double GetOpen(int index) const {
+		return TicksToPrice(opens[index]);
+	}
+
+	double GetHigh(int index) const {
+		return TicksToPrice(highs[index]);
+	}
+
+	double GetLow(int index) const {
+		return TicksToPrice(lows[index]);
+	}
+
+	double GetClose(int index) const {
+		return TicksToPrice(closes[index]);
+	}
+
+	double GetVolume(int index) const {
+		return (double) volumes[index];
+	}
+
+	/* Materializes the candle at the given index along with its derived fields. */
+	StockCandle GetStockCandle(int index) const {
+		tm close_time;
+		localtime_r(&close_times[index], &close_time);
+
+		StockCandle candle(symbol, close_time, TicksToPrice(opens[index]), TicksToPrice(highs[index]),
+			TicksToPrice(lows[index]), TicksToPrice(closes[index]), (double) volumes[index]);
+		candle.average_volume = GetAverageVolume(index);
+		candle.average_volume_days = average_volume_days;
+		return candle;
+	}
+
+	string symbol;
+	int average_volume_days;
+	bool exact;
+
+private:
+	vector<time_t> close_times;
+	vector<int32_t> opens;
+	vector<int32_t> highs;
+	vector<int32_t> lows;
+	vector<int32_t> closes;
+	vector<int64_t> volumes;
+};
+
+/*
+ * Merged view over the compact candles of multiple stocks, indexed the same way as the merged
+ * double precision candles: index 0 is the latest timestamp. Indexing materializes the candles
+ * for that timestamp, so only one timestamp worth of StockCandle is alive at a time.
+ *
+ * The stock candles passed to the constructor should outlive this object.
+ */
+class CompactMergedCandles {
+public:
+	CompactMergedCandles(const vector<CompactStockCandles>& multiple_stock_candles) {
+		this->multiple_stock_candles = &multiple_stock_candles;
+
+		vector<vector<time_t> > multiple_close_times;
+		for(const CompactStockCandles& candles: multiple_stock_candles) {
+			multiple_close_times.push_back(candles.GetCloseTimes());
+		}
+
+		for(pair<time_t, vector<pair<int, int> > >& merged_close_time: MergeCloseTimes(multiple_close_times)) {
+			times.push_back(merged_close_time.first);
+			merged_indexes.push_back(std::move(merged_close_time.second));
+		}
+	}
+
+	int size() const {
+		return times.size();
+	}
+
+	time_t GetTime(int index) const {
+		return times[index];
+	}
+
+	tm GetTimestamp(int index) const {
+		tm timestamp;
+		localtime_r(&times[index], &timestamp);
+		return timestamp;
+	}
+
+	int GetNumCandles(int index) const {
+		return merged_indexes[index].size();
+	}
+
+	/* Materializes a single candle of the timestamp. */
+	StockCandle GetStockCandle(int index, int position) const {
+		const pair<int, int>& candle_index = merged_indexes[index][position];
+		return (*multiple_stock_candles)[candle_index.first].GetStockCandle(candle_index.second);
+	}
+
+	/* Returns the candles of the stock of a candle of the timestamp, and the index of the candle in them. */
+	const CompactStockCandles& GetStockCandles(int index, int position, int* candle_index) const {
+		const pair<int, int>& stock_candle_index = merged_indexes[index][position];
+		*candle_index = stock_candle_index.second;
+		return (*multiple_stock_candles)[stock_candle_index.first];
+	}
+
+	pair<tm, vector<StockCandle> > operator[](int index) const {
+		pair<tm, vector<StockCandle> > candles_for_timestamp;
+		localtime_r(&times[index], &candles_for_timestamp.first);
+
+		for(const pair<int, int>& candle_index: merged_indexes[index]) {
+			candles_for_timestamp.second.push_back(
+				(*multiple_stock_candles)[candle_index.first].GetStockCandle(candle_index.second));
+		}
+
+		return candles_for_timestamp;
+	}
+
+private:
+	const vector<CompactStockCandles>* multiple_stock_candles;
+
+	/* (stock index, candle index) of the candles for every timestamp. */
+	vector<vector<pair<int, int> > > merged_indexes;
+	vector<time_t> times;
+};
+
+/*
+ * Checks that all the prices and volumes of the stocks are exact in ticks, so that the compact
+ * candles replay exactly like the double precision candles.
+ *
+ * returns bool: true if the candles of all the stocks are exact, the other symbols are printed otherwise.
+ */
+bool AreCompactStockCandlesExact(const vector<CompactStockCandles>& multiple_stock_candles) {
+	bool exact = true;
+	for(const CompactStockCandles& candles: multiple_stock_candles) {
+		if(!candles.exact) {
+			std::cout << "Prices or volumes of " << candles.symbol << " are not exact in ticks." << endl;
+			exact = false;
+		}
+	}
+
+	return exact;
+}
+
+/*
+ * Checks that every candle materialized from the compact representation is exactly equal,
+ * including the derived fields, to the double precision candle. If this holds all the trade
+ * decisions (including the eps comparisons) of the two paths are identical.
+ *
+ * returns bool: true if all the candles match, the first mismatch is printed otherwise.
+ */
+bool ValidateCompactStockCandles(const vector<StockCandle>& candles, const CompactStockCandles& compact_candles) {
+	if((int) candles.size() != compact_candles.Size()) {
+		std::cout << "Compact candles size mismatch for " << compact_candles.symbol << ": "
+			<< candles.size() << " vs " << compact_candles.Size() << endl;
+		return false;
+	}
+
+	for(int i=0; i<compact_candles.Size(); i++) {
+		StockCandle compact_candle = compact_candles.GetStockCandle(i);
+		tm close_time = candles[i].close_time;
+
+		if(mktime(&close_time) != compact_candles.GetCloseTime(i) ||
+			candles[i].open != compact_candle.open ||
+			candles[i].high != compact_candle.high ||
+			candles[i].low != compact_candle.low ||
+			candles[i].close != compact_candle.close ||
+			candles[i].volume != compact_candle.volume ||
+			candles[i].colour.colour != compact_candle.colour.colour ||
+			candles[i].body != compact_candle.body ||
+			candles[i].upper_shadow != compact_candle.upper_shadow ||
+			candles[i].lower_shadow != compact_candle.lower_shadow ||
+			candles[i].average_volume != compact_candle.average_volume) {
+			std::cout << "Compact candle mismatch: " << candles[i] << "vs " << compact_candle;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+}
+
+#endif
\ No newline at end of file
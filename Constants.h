@@ -15,6 +15,13 @@ std::vector<std::string> kNifty50 {"ADANIPORTS", "ASIANPAINT", "AXISBANK", "BAJA
 							"SUNPHARMA", "TATAMOTORS", "TATASTEEL", "TCS", "TECHM", "TITAN", "ULTRACEMCO", "UPL",
 							"VEDL", "WIPRO", "YESBANK", "ZEEL"};
 
+/* Directory with one Google finance CSV per stock, named <symbol>.csv. */
+const std::string kStockDataDirectory = "Data/Stock_OLHC/";
+
+/* Defaults for the backtests, in the Google finance date time format. */
+const std::string kBacktestStartTime = "6/22/2008 15:30:00";
+const double kInitialCapital = 100000;
+
 }
 }
 
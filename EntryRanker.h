@@ -0,0 +1,90 @@
+#ifndef ENTRY_RANKER_H
+#define ENTRY_RANKER_H
+
+#include <iostream>
+#include <memory>
+#include <limits>
+
+#include "BacktestCriteria.h"
+#include "StockCandle.h"
+
+using namespace std;
+
+namespace finance {
+
+/*
+ * Scores the buy signals of a day, the signals with the highest scores are bought first.
+ * Implement this to plug a custom ranking into RunBacktest.
+ */
+class EntryRanker {
+public:
+	virtual ~EntryRanker() {}
+
+	/*
+	 * lookback_candle: the candle of the stock GetLookbackDays() candles before, nullptr if the
+	 * ranker does not need it or if there is no such candle.
+	 */
+	virtual double GetScore(const StockCandle& candle, const StockCandle* lookback_candle) const = 0;
+
+	virtual int GetLookbackDays() const {
+		return 0;
+	}
+};
+
+class BodyEntryRanker: public EntryRanker {
+public:
+	double GetScore(const StockCandle& candle, const StockCandle*) const {
+		return candle.body;
+	}
+};
+
+class VolumeRatioEntryRanker: public EntryRanker {
+public:
+	double GetScore(const StockCandle& candle, const StockCandle*) const {
+		if(candle.average_volume <= 0) {
+			return 0;
+		}
+
+		return candle.volume/candle.average_volume;
+	}
+};
+
+class MomentumEntryRanker: public EntryRanker {
+public:
+	MomentumEntryRanker(int num_days) {
+		this->num_days = num_days;
+	}
+
+	double GetScore(const StockCandle& candle, const StockCandle* lookback_candle) const {
+		/* Signals without enough history are ranked last. */
+		if(lookback_candle == nullptr) {
+			return -std::numeric_limits<double>::infinity();
+		}
+
+		return (candle.close - lookback_candle->close)/lookback_candle->close;
+	}
+
+	int GetLookbackDays() const {
+		return num_days;
+	}
+
+private:
+	int num_days;
+};
+
+/*
+ * Returns the ranker for the score of the criteria.
+ */
+std::unique_ptr<EntryRanker> CreateEntryRanker(const RankingCriteria& criteria) {
+	if(criteria.score == RankingCriteria::VOLUME_RATIO) {
+		return std::unique_ptr<EntryRanker>(new VolumeRatioEntryRanker());
+	} else if(criteria.score == RankingCriteria::MOMENTUM) {
+		return std::unique_ptr<EntryRanker>(new MomentumEntryRanker(criteria.momentum_days));
+	}
+
+	return std::unique_ptr<EntryRanker>(new BodyEntryRanker());
+}
+
+}
+
+#endif
\ No newline at end of file
@@ -1,7 +1,12 @@
+#ifndef GOOGLE_FINANCE_DATA_READER_H
+#define GOOGLE_FINANCE_DATA_READER_H
+
 #include <iostream>
+#include <fstream>
 #include <sstream>
 #include <vector>
 #include "StockCandle.h"
+#include "CompactStockCandle.h"
 
 using namespace std;
 
@@ -10,14 +15,28 @@ namespace finance {
 const string kGoogleFinanceDateTimeFormat = "%m/%d/%Y %H:%M:%S";
 
 /*
- * This method returns the stock candles read from a CSV generated from Goolge finance.
+ * A row of a CSV generated from Google finance.
+ */
+struct GoogleFinanceRow {
+	tm close_time;
+	double open;
+	double high;
+	double low;
+	double close;
+	double volume;
+};
+
+/*
+ * This method returns the rows read from a CSV generated from Google finance, in the order of the
+ * file. Both the double precision and the compact candles are read with it, so that they are
+ * parsed exactly the same way.
  * The format expected for the CSV file is:
  * Date, Open, High, Low, Close, Volume
  *
  * filename: the relative path to the file that contains the stock data.
  */
-vector<StockCandle> GetStockCandles(string filename, string stock_symbol, BacktestCriteria criteria) {
-	vector<StockCandle> candles;
+vector<GoogleFinanceRow> GetGoogleFinanceRows(const string& filename) {
+	vector<GoogleFinanceRow> rows;
 	std::ifstream file(filename);
 	bool first_line_skipped = false;
 
@@ -38,12 +57,34 @@ vector<StockCandle> GetStockCandles(string filename, string stock_symbol, Backte
 			line_splits.push_back(token);
 		}
 
-
-		StockCandle candle = StockCandle(line_splits, stock_symbol, kGoogleFinanceDateTimeFormat);
-		candles.push_back(candle);
+		GoogleFinanceRow row;
+		/* strptime only sets the parsed fields, the rest is cleared so that mktime is deterministic. */
+		row.close_time = tm();
+		strptime(line_splits[0].c_str(), kGoogleFinanceDateTimeFormat.c_str(), &row.close_time);
+		row.close_time.tm_isdst = -1;
+		row.open = stod(line_splits[1], nullptr);
+		row.high = stod(line_splits[2], nullptr);
+		row.low = stod(line_splits[3], nullptr);
+		row.close = stod(line_splits[4], nullptr);
+		row.volume = stod(line_splits[5], nullptr);
+		rows.push_back(row);
 	}
 
 	file.close();
+	return rows;
+}
+
+/*
+ * This method returns the stock candles read from a CSV generated from Goolge finance.
+ * The format expected for the CSV file is the one of GetGoogleFinanceRows.
+ *
+ * filename: the relative path to the file that contains the stock data.
+ */
+vector<StockCandle> GetStockCandles(string filename, string stock_symbol, BacktestCriteria criteria) {
+	vector<StockCandle> candles;
+	for(const GoogleFinanceRow& row: GetGoogleFinanceRows(filename)) {
+		candles.push_back(StockCandle(stock_symbol, row.close_time, row.open, row.high, row.low, row.close, row.volume));
+	}
 
 	/* Computing and setting average volume in candles. */
 	double total_volume = 0;
@@ -65,4 +106,38 @@ vector<StockCandle> GetStockCandles(string filename, string stock_symbol, Backte
 	return candles;
 }
 
-}
\ No newline at end of file
+/*
+ * This method returns the stock candles read from a CSV generated from Google finance in the
+ * compact representation. The expected format is the same as for GetStockCandles.
+ *
+ * filename: the relative path to the file that contains the stock data.
+ */
+CompactStockCandles GetCompactStockCandles(string filename, string stock_symbol, BacktestCriteria criteria) {
+	CompactStockCandles candles;
+	candles.symbol = stock_symbol;
+	candles.average_volume_days = criteria.buy_volume_criteria.num_days;
+
+	for(const GoogleFinanceRow& row: GetGoogleFinanceRows(filename)) {
+		/* Converting the prices to ticks, the candles are not exact if any conversion loses precision. */
+		double row_prices[4] = {row.open, row.high, row.low, row.close};
+		int32_t prices[4];
+		for(int i=0; i<4; i++) {
+			if(!CompactStockCandles::PriceToTicks(row_prices[i], &prices[i])) {
+				candles.exact = false;
+			}
+		}
+
+		if(((double) llround(row.volume)) != row.volume) {
+			candles.exact = false;
+		}
+
+		tm close_time = row.close_time;
+		candles.Append(mktime(&close_time), prices[0], prices[1], prices[2], prices[3], llround(row.volume));
+	}
+
+	return candles;
+}
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,291 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdlib>
+#include <cctype>
+
+using namespace std;
+
+namespace finance {
+
+/* Maximum nesting of arrays and objects, deeper values are rejected instead of exhausting the stack. */
+const int kJsonMaxDepth = 64;
+
+/*
+ * Minimal JSON value, enough for the requests and responses of the backtest daemon.
+ * Numbers are stored as double and objects keep their keys sorted.
+ */
+class JsonValue {
+public:
+	enum Type {
+		NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT
+	};
+
+	JsonValue() {
+		type = NUL;
+		boolean = false;
+		number = 0;
+	}
+
+	bool IsObject() const {
+		return type == OBJECT;
+	}
+
+	bool HasMember(const string& key) const {
+		return (type == OBJECT) && (members.find(key) != members.end());
+	}
+
+	/* Returns the member of an object, a null value if there is none. */
+	const JsonValue& GetMember(const string& key) const {
+		static const JsonValue null_value;
+		if(type != OBJECT) {
+			return null_value;
+		}
+
+		auto it = members.find(key);
+		if(it == members.end()) {
+			return null_value;
+		}
+
+		return it->second;
+	}
+
+	/*
+	 * Parses the JSON text.
+	 *
+	 * returns bool: true if the text is a single valid JSON value, error is set otherwise.
+	 */
+	static bool Parse(const string& text, JsonValue* value, string* error) {
+		size_t position = 0;
+		if(!ParseValue(text, &position, 0, value, error)) {
+			return false;
+		}
+
+		SkipWhitespace(text, &position);
+		if(position != text.size()) {
+			*error = "unexpected characters after the JSON value at position " + to_string(position);
+			return false;
+		}
+
+		return true;
+	}
+
+	/* Returns the text quoted and escaped as a JSON string. */
+	static string Quote(const string& text) {
+		stringstream output;
+		output << '"';
+		for(char character: text) {
+			if(character == '"' || character == '\\') {
+				output << '\\' << character;
+			} else if(character == '\n') {
+				output << "\\n";
+			} else if(character == '\t') {
+				output << "\\t";
+			} else if((unsigned char) character < 0x20) {
+				output << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int) character << std::dec;
+			} else {
+				output << character;
+			}
+		}
+		output << '"';
+		return output.str();
+	}
+
+	Type type;
+	bool boolean;
+	double number;
+	string text;
+	vector<JsonValue> elements;
+	map<string, JsonValue> members;
+
+private:
+	static void SkipWhitespace(const string& text, size_t* position) {
+		while(*position < text.size() && isspace((unsigned char) text[*position])) {
+			(*position)++;
+		}
+	}
+
+	static bool ParseLiteral(const string& text, size_t* position, const string& literal) {
+		if(text.compare(*position, literal.size(), literal) != 0) {
+			return false;
+		}
+
+		*position += literal.size();
+		return true;
+	}
+
+	static bool ParseString(const string& text, size_t* position, string* result, string* error) {
+		/* Skipping the opening quote. */
+		(*position)++;
+
+		while(*position < text.size()) {
+			char character = text[(*position)++];
+			if(character == '"') {
+				return true;
+			}
+
+			if(character != '\\') {
+				result->push_back(character);
+				continue;
+			}
+
+			if(*position >= text.size()) {
+				break;
+			}
+
+			char escaped = text[(*position)++];
+			if(escaped == 'n') {
+				result->push_back('\n');
+			} else if(escaped == 't') {
+				result->push_back('\t');
+			} else if(escaped == 'r') {
+				result->push_back('\r');
+			} else if(escaped == 'b') {
+				result->push_back('\b');
+			} else if(escaped == 'f') {
+				result->push_back('\f');
+			} else if(escaped == 'u') {
+				/* Only the ASCII range is supported, which is all the requests need. */
+				if(*position + 4 > text.size()) {
+					break;
+				}
+
+				long code = strtol(text.substr(*position, 4).c_str(), nullptr, 16);
+				if(code > 0x7f) {
+					*error = "unsupported unicode escape at position " + to_string(*position);
+					return false;
+				}
+
+				result->push_back((char) code);
+				*position += 4;
+			} else {
+				result->push_back(escaped);
+			}
+		}
+
+		*error = "unterminated string";
+		return false;
+	}
+
+	/* depth: number of arrays and objects the value is nested in. */
+	static bool ParseValue(const string& text, size_t* position, int depth, JsonValue* value, string* error) {
+		SkipWhitespace(text, position);
+		if(*position >= text.size()) {
+			*error = "unexpected end of JSON";
+			return false;
+		}
+
+		char character = text[*position];
+		if((character == '{' || character == '[') && depth >= kJsonMaxDepth) {
+			*error = "JSON nested deeper than " + to_string(kJsonMaxDepth) + " levels at position " + to_string(*position);
+			return false;
+		}
+
+		if(character == '{') {
+			value->type = OBJECT;
+			(*position)++;
+			SkipWhitespace(text, position);
+			if(*position < text.size() && text[*position] == '}') {
+				(*position)++;
+				return true;
+			}
+
+			while(1) {
+				SkipWhitespace(text, position);
+				if(*position >= text.size() || text[*position] != '"') {
+					*error = "expected a member name at position " + to_string(*position);
+					return false;
+				}
+
+				string key;
+				if(!ParseString(text, position, &key, error)) {
+					return false;
+				}
+
+				SkipWhitespace(text, position);
+				if(*position >= text.size() || text[*position] != ':') {
+					*error = "expected ':' at position " + to_string(*position);
+					return false;
+				}
+				(*position)++;
+
+				if(!ParseValue(text, position, depth + 1, &value->members[key], error)) {
+					return false;
+				}
+
+				SkipWhitespace(text, position);
+				if(*position < text.size() && text[*position] == ',') {
+					(*position)++;
+				} else if(*position < text.size() && text[*position] == '}') {
+					(*position)++;
+					return true;
+				} else {
+					*error = "expected ',' or '}' at position " + to_string(*position);
+					return false;
+				}
+			}
+		} else if(character == '[') {
+			value->type = ARRAY;
+			(*position)++;
+			SkipWhitespace(text, position);
+			if(*position < text.size() && text[*position] == ']') {
+				(*position)++;
+				return true;
+			}
+
+			while(1) {
+				value->elements.push_back(JsonValue());
+				if(!ParseValue(text, position, depth + 1, &value->elements.back(), error)) {
+					return false;
+				}
+
+				SkipWhitespace(text, position);
+				if(*position < text.size() && text[*position] == ',') {
+					(*position)++;
+				} else if(*position < text.size() && text[*position] == ']') {
+					(*position)++;
+					return true;
+				} else {
+					*error = "expected ',' or ']' at position " + to_string(*position);
+					return false;
+				}
+			}
+		} else if(character == '"') {
+			value->type = STRING;
+			return ParseString(text, position, &value->text, error);
+		} else if(ParseLiteral(text, position, "true")) {
+			value->type = BOOLEAN;
+			value->boolean = true;
+			return true;
+		} else if(ParseLiteral(text, position, "false")) {
+			value->type = BOOLEAN;
+			value->boolean = false;
+			return true;
+		} else if(ParseLiteral(text, position, "null")) {
+			value->type = NUL;
+			return true;
+		}
+
+		const char* start = text.c_str() + *position;
+		char* end;
+		value->number = strtod(start, &end);
+		if(end == start) {
+			*error = "unexpected character at position " + to_string(*position);
+			return false;
+		}
+
+		value->type = NUMBER;
+		*position += end - start;
+		return true;
+	}
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,319 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <future>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include "BacktestCriteria.h"
+#include "BacktestCriteriaJson.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+namespace finance {
+
+/*
+ * A continuous criteria field to optimize.
+ * field: path of the field, as accepted by SetBacktestCriteriaField (e.g. "exit_gain_criteria.gain_percentage").
+ */
+struct OptimizerParameter {
+	string field;
+	double minimum;
+	double maximum;
+};
+
+/*
+ * Options of the optimizer.
+ *
+ * seed: seed of the random generator, the same seed and options give the same search.
+ * population_size: number of configurations proposed and evaluated concurrently per generation,
+ *   should be more than num_elites so that every generation evaluates new configurations.
+ * max_evaluations: budget in number of backtests, unlimited if not positive.
+ * max_seconds: budget in wall clock seconds, unlimited if not positive. The search stops after the
+ *   generation that crosses the budget, so the result only depends on the seed if this is unset.
+ *   At least one of the two budgets should be set.
+ */
+struct OptimizerOptions {
+	OptimizerOptions() {
+		seed = 1;
+		population_size = 32;
+		num_elites = 2;
+		tournament_size = 3;
+		initial_mutation_scale = 0.2;
+		minimum_mutation_scale = 0.02;
+		mutation_decay = 0.9;
+		max_evaluations = 1000;
+		max_seconds = 0;
+	}
+
+	unsigned long long seed;
+	int population_size;
+	int num_elites;
+	int tournament_size;
+	double initial_mutation_scale;
+	double minimum_mutation_scale;
+	double mutation_decay;
+	int max_evaluations;
+	double max_seconds;
+};
+
+struct OptimizerResult {
+	BacktestCriteria best_criteria;
+	vector<double> best_values;
+	double best_score;
+	int num_evaluations;
+	int num_generations;
+};
+
+/*
+ * Genetic optimizer over the continuous fields of BacktestCriteria.
+ *
+ * Every generation keeps the best configurations, breeds the rest of the population from
+ * tournament selected parents with blend crossover and gaussian mutation, whose scale shrinks
+ * every generation so that the search converges around the good regions. The configurations of a
+ * generation are evaluated concurrently on the thread pool. The proposals only depend on the seed,
+ * not on the order in which the evaluations finish.
+ */
+class GeneticOptimizer {
+public:
+	/*
+	 * evaluate: returns the score of a criteria, higher is better. Called concurrently.
+	 */
+	GeneticOptimizer(const BacktestCriteria& base_criteria, const vector<OptimizerParameter>& parameters,
+		const OptimizerOptions& options, std::function<double(const BacktestCriteria&)> evaluate,
+		ThreadPool* thread_pool) : random_generator(options.seed) {
+		this->base_criteria = base_criteria;
+		this->parameters = parameters;
+		this->options = options;
+		this->evaluate = evaluate;
+		this->thread_pool = thread_pool;
+	}
+
+	/*
+	 * Runs the search until the budget is exhausted.
+	 *
+	 * returns bool: true if the search ran, error is set if a parameter or an option is invalid.
+	 */
+	bool Optimize(OptimizerResult* result, string* error) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if(options.population_size <= 0 || options.population_size <= options.num_elites) {
+			*error = "population size should be more than the " + to_string(options.num_elites) + " elites";
+			return false;
+		}
+
+		if(options.max_evaluations <= 0 && options.max_seconds <= 0) {
+			*error = "either the maximum evaluations or the maximum seconds should be set";
+			return false;
+		}
+
+		BacktestCriteria criteria;
+		for(const OptimizerParameter& parameter: parameters) {
+			if(parameter.minimum > parameter.maximum) {
+				*error = "invalid range for " + parameter.field;
+				return false;
+			}
+
+			if(!SetParameter(parameter.field, parameter.minimum, &criteria, error)) {
+				return false;
+			}
+		}
+
+		/* The first generation is sampled uniformly over the ranges. */
+		vector<Individual> population;
+		for(int i=0; i<options.population_size; i++) {
+			Individual individual;
+			for(const OptimizerParameter& parameter: parameters) {
+				std::uniform_real_distribution<double> distribution(parameter.minimum, parameter.maximum);
+				individual.values.push_back(distribution(random_generator));
+			}
+			population.push_back(individual);
+		}
+
+		result->best_score = -std::numeric_limits<double>::infinity();
+		result->num_evaluations = 0;
+		result->num_generations = 0;
+		double mutation_scale = options.initial_mutation_scale;
+		while(1) {
+			if(!Evaluate(&population, result)) {
+				break;
+			}
+			result->num_generations++;
+
+			std::sort(population.begin(), population.end(), [](const Individual& first, const Individual& second) {
+				return first.score > second.score;
+			});
+
+			if(population[0].score > result->best_score) {
+				result->best_score = population[0].score;
+				result->best_values = population[0].values;
+			}
+
+			std::cout << "Generation: " << result->num_generations
+				<< " Evaluations: " << result->num_evaluations
+				<< " Best score: " << result->best_score << endl;
+
+			double elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if((options.max_evaluations > 0 && result->num_evaluations >= options.max_evaluations) ||
+				(options.max_seconds > 0 && elapsed_seconds >= options.max_seconds)) {
+				break;
+			}
+
+			population = Breed(population, mutation_scale);
+			mutation_scale = std::max(options.minimum_mutation_scale, mutation_scale*options.mutation_decay);
+		}
+
+		result->best_criteria = GetCriteria(result->best_values);
+		return true;
+	}
+
+private:
+	struct Individual {
+		Individual() {
+			evaluated = false;
+			score = -std::numeric_limits<double>::infinity();
+		}
+
+		vector<double> values;
+		bool evaluated;
+		double score;
+	};
+
+	BacktestCriteria GetCriteria(const vector<double>& values) const {
+		BacktestCriteria criteria = base_criteria;
+		for(int i=0; i<(int) parameters.size() && i<(int) values.size(); i++) {
+			string error;
+			SetParameter(parameters[i].field, values[i], &criteria, &error);
+		}
+
+		return criteria;
+	}
+
+	/* Sets the field to the value, the integer fields (e.g. ranking_criteria.momentum_days) to the nearest integer. */
+	static bool SetParameter(const string& field, double number, BacktestCriteria* criteria, string* error) {
+		JsonValue value;
+		value.type = JsonValue::NUMBER;
+		value.number = number;
+		if(SetBacktestCriteriaField(field, value, criteria, error)) {
+			return true;
+		}
+
+		value.number = std::round(number);
+		return SetBacktestCriteriaField(field, value, criteria, error);
+	}
+
+	/*
+	 * Evaluates the individuals that do not have a score yet, within the remaining budget.
+	 * Individuals left out by the budget are dropped.
+	 *
+	 * returns bool: false if nothing was evaluated.
+	 */
+	bool Evaluate(vector<Individual>* population, OptimizerResult* result) {
+		vector<int> indexes;
+		for(int i=0; i<(int) population->size(); i++) {
+			if(!(*population)[i].evaluated) {
+				indexes.push_back(i);
+			}
+		}
+
+		if(options.max_evaluations > 0) {
+			int remaining = options.max_evaluations - result->num_evaluations;
+			if(remaining <= 0) {
+				return false;
+			}
+
+			if((int) indexes.size() > remaining) {
+				int last_index = indexes[remaining];
+				indexes.resize(remaining);
+				population->erase(population->begin() + last_index, population->end());
+			}
+		}
+
+		if(indexes.empty()) {
+			return false;
+		}
+
+		vector<std::future<double> > scores;
+		for(int index: indexes) {
+			BacktestCriteria criteria = GetCriteria((*population)[index].values);
+			std::function<double(const BacktestCriteria&)> evaluate = this->evaluate;
+			scores.push_back(thread_pool->Submit([evaluate, criteria]() {
+				return evaluate(criteria);
+			}));
+		}
+
+		for(int i=0; i<(int) indexes.size(); i++) {
+			double score = scores[i].get();
+			Individual& individual = (*population)[indexes[i]];
+			individual.score = std::isnan(score) ? -std::numeric_limits<double>::infinity() : score;
+			individual.evaluated = true;
+		}
+
+		result->num_evaluations += indexes.size();
+		return true;
+	}
+
+	/* Picks the best of tournament_size random individuals of the sorted population. */
+	const Individual& SelectParent(const vector<Individual>& population) {
+		std::uniform_int_distribution<int> distribution(0, population.size() - 1);
+		int best_index = distribution(random_generator);
+		for(int i=1; i<options.tournament_size; i++) {
+			best_index = std::min(best_index, distribution(random_generator));
+		}
+
+		return population[best_index];
+	}
+
+	/*
+	 * Returns the next generation: the elites unchanged, the rest from crossover and mutation.
+	 * population: sorted by decreasing score.
+	 */
+	vector<Individual> Breed(const vector<Individual>& population, double mutation_scale) {
+		vector<Individual> next_population;
+		for(int i=0; i<options.num_elites && i<(int) population.size(); i++) {
+			next_population.push_back(population[i]);
+		}
+
+		std::uniform_real_distribution<double> unit_distribution(0, 1);
+		std::normal_distribution<double> normal_distribution(0, 1);
+		while((int) next_population.size() < options.population_size) {
+			const Individual& first_parent = SelectParent(population);
+			const Individual& second_parent = SelectParent(population);
+
+			Individual child;
+			for(int i=0; i<(int) parameters.size(); i++) {
+				/* Blend crossover, the child is anywhere in the extended range between the parents. */
+				double low = std::min(first_parent.values[i], second_parent.values[i]);
+				double high = std::max(first_parent.values[i], second_parent.values[i]);
+				double extension = 0.5*(high - low);
+				double value = low - extension + unit_distribution(random_generator)*(high - low + 2*extension);
+
+				double range = parameters[i].maximum - parameters[i].minimum;
+				value += normal_distribution(random_generator)*mutation_scale*range;
+				value = std::max(parameters[i].minimum, std::min(parameters[i].maximum, value));
+				child.values.push_back(value);
+			}
+
+			next_population.push_back(child);
+		}
+
+		return next_population;
+	}
+
+	BacktestCriteria base_criteria;
+	vector<OptimizerParameter> parameters;
+	OptimizerOptions options;
+	std::function<double(const BacktestCriteria&)> evaluate;
+	ThreadPool* thread_pool;
+	std::mt19937_64 random_generator;
+};
+
+}
+
+#endif
\ No newline at end of file
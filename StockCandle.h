@@ -56,14 +56,37 @@ public:
 	StockCandle(const vector<string>& google_finance_splits, const string& symbol, const string& date_format) {
 		this->symbol = symbol;
 		this->duration.duration = CandleDuration::DAY;
+		/* strptime only sets the parsed fields, the rest is cleared so that mktime is deterministic. */
+		this->close_time = tm();
 		strptime(google_finance_splits[0].c_str(), date_format.c_str(), &this->close_time);
+		this->close_time.tm_isdst = -1;
 		this->open = stod(google_finance_splits[1], nullptr);
 		this->high = stod(google_finance_splits[2], nullptr);
 		this->low = stod(google_finance_splits[3], nullptr);
 		this->close = stod(google_finance_splits[4], nullptr);
 		this->volume = stod(google_finance_splits[5], nullptr);
+		ComputeDerivedFields();
+	}
+
+	/*
+	 * This constructor should be used to create the stock candle from already parsed prices,
+	 * e.g. when materializing a candle from the compact representation.
+	 */
+	StockCandle(const string& symbol, const tm& close_time, double open, double high, 
+		double low, double close, double volume) {
+		this->symbol = symbol;
+		this->duration.duration = CandleDuration::DAY;
+		this->close_time = close_time;
+		this->open = open;
+		this->high = high;
+		this->low = low;
+		this->close = close;
+		this->volume = volume;
+		ComputeDerivedFields();
+	}
 
-		/* Computing other fields. */
+	/* Computes the colour, body and shadows from the prices. */
+	void ComputeDerivedFields() {
 		if(this->open > this->close) {
 			this->colour.colour = CandleColour::RED;
 			this->upper_shadow = (this->high - this->open)/this->open;
@@ -0,0 +1,108 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+using namespace std;
+
+namespace finance {
+
+/*
+ * Fixed size pool of worker threads executing the submitted tasks in submission order.
+ */
+class ThreadPool {
+public:
+	/*
+	 * num_threads: number of workers, the number of hardware threads if not positive.
+	 */
+	ThreadPool(int num_threads) {
+		if(num_threads <= 0) {
+			num_threads = std::thread::hardware_concurrency();
+		}
+
+		if(num_threads <= 0) {
+			num_threads = 1;
+		}
+
+		stopping = false;
+		for(int i=0; i<num_threads; i++) {
+			workers.push_back(std::thread(&ThreadPool::Work, this));
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			stopping = true;
+		}
+
+		condition.notify_all();
+		for(std::thread& worker: workers) {
+			worker.join();
+		}
+	}
+
+	/*
+	 * Queues the task for execution.
+	 *
+	 * returns future: the result of the task, available once it has been executed.
+	 */
+	template <typename Task>
+	std::future<typename std::result_of<Task()>::type> Submit(Task task) {
+		typedef typename std::result_of<Task()>::type Result;
+
+		/* packaged_task is not copyable, so it is shared with the queued function. */
+		std::shared_ptr<std::packaged_task<Result()> > packaged_task =
+			std::make_shared<std::packaged_task<Result()> >(task);
+		std::future<Result> result = packaged_task->get_future();
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			tasks.push([packaged_task]() { (*packaged_task)(); });
+		}
+
+		condition.notify_one();
+		return result;
+	}
+
+	int GetNumThreads() const {
+		return workers.size();
+	}
+
+private:
+	void Work() {
+		while(1) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+				if(stopping && tasks.empty()) {
+					return;
+				}
+
+				task = tasks.front();
+				tasks.pop();
+			}
+
+			task();
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()> > tasks;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping;
+};
+
+}
+
+#endif
\ No newline at end of file
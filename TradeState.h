@@ -1,5 +1,10 @@
+#ifndef TRADE_STATE_H
+#define TRADE_STATE_H
+
 #include <iostream>
 #include <map>
+#include <vector>
+#include <iomanip>
 
 #include "StockCandle.h"
 #include "Constants.h"
@@ -67,34 +72,60 @@ public:
 		print_trade_candles = true;
 	}
 
+	/*
+	 * Checks if the candle is a buy signal, regardless of the ongoing trades.
+	 * Only depends on the candle and the criteria, so it can be precomputed for all the candles.
+	 */
+	static bool IsBuySignal(const StockCandle& candle, const BacktestCriteria& criteria) {
+		/* Checking the volume criteria. */
+		if(criteria.buy_volume_criteria.enabled) {
+			if(candle.volume < candle.average_volume*criteria.buy_volume_criteria.average_volume_threshold) {
+				return false;
+			}
+		}
+
+		/* Checking the RSI criteria. */
+		if(criteria.rsi_criteria.enabled) {
+			if(candle.rsi_computed && (candle.rsi > criteria.rsi_criteria.overbought_threshold)) {
+				return false;
+			}
+		}
+
+		/* Checking if Marubozu is enabled. */
+		if(criteria.marubozu_criteria.enabled) {
+			if(!candle.IsBullishMarubozu(criteria.marubozu_criteria)) {
+				return false;
+			}
+
+			return true;
+		}
+
+		return false;
+	}
+
 	bool DoesFitBuyCriteria(const StockCandle& candle, const BacktestCriteria& criteria) {
 		auto it = trade_map.find(candle.symbol);
 		if(!it->second.trade_ongoing) {
-			/* Checking the volume criteria. */
-			if(criteria.buy_volume_criteria.enabled) {
-				if(candle.volume < candle.average_volume*criteria.buy_volume_criteria.average_volume_threshold) {
-					return false;
-				}
-			}
+			return IsBuySignal(candle, criteria);
+		}
 
-			/* Checking the RSI criteria. */
-			if(criteria.rsi_criteria.enabled) {
-				if(candle.rsi_computed && (candle.rsi > criteria.rsi_criteria.overbought_threshold)) {
-					return false;
-				}
-			}
+		return false;
+	}
 
-			/* Checking if Marubozu is enabled. */
-			if(criteria.marubozu_criteria.enabled) {
-				if(!candle.IsBullishMarubozu(criteria.marubozu_criteria)) {
-					return false;
-				}
+	bool IsTradeOngoing(const string& symbol) const {
+		auto it = trade_map.find(symbol);
+		return (it != trade_map.end()) && it->second.trade_ongoing;
+	}
 
-				return true;
+	vector<string> GetOngoingSymbols() const {
+		vector<string> symbols;
+		for(auto it = trade_map.begin(); it != trade_map.end(); it++) {
+			if(it->second.trade_ongoing) {
+				symbols.push_back(it->first);
 			}
 		}
 
-		return false;
+		return symbols;
 	}
 
 	double BuyIfFitsCriteria(const StockCandle& candle, double capital, const BacktestCriteria& criteria) {
@@ -177,6 +208,63 @@ public:
         return output;            
     }
 
+	/*
+	 * Writes the wins, losses and the ongoing trades to the stream, in the format read by ReadFrom.
+	 * The prices are written with full precision so that a resumed backtest is exact.
+	 */
+	void WriteTo(ostream& output) const {
+		output << std::setprecision(17);
+		output << "wins " << wins << endl;
+		output << "losses " << losses << endl;
+
+		int num_ongoing_trades = 0;
+		for(auto it = trade_map.begin(); it != trade_map.end(); it++) {
+			if(it->second.trade_ongoing) {
+				num_ongoing_trades++;
+			}
+		}
+
+		output << "ongoing_trades " << num_ongoing_trades << endl;
+		for(auto it = trade_map.begin(); it != trade_map.end(); it++) {
+			if(it->second.trade_ongoing) {
+				output << it->first << " " << it->second.stocks_held << " " 
+					<< it->second.buy_price << " " << it->second.stop_loss << endl;
+			}
+		}
+	}
+
+	/*
+	 * Reads the state written by WriteTo.
+	 *
+	 * returns bool: true if the state was read successfully.
+	 */
+	bool ReadFrom(istream& input) {
+		string key;
+		int num_ongoing_trades;
+		if(!(input >> key >> wins) || key != "wins" ||
+			!(input >> key >> losses) || key != "losses" ||
+			!(input >> key >> num_ongoing_trades) || key != "ongoing_trades") {
+			return false;
+		}
+
+		for(int i=0; i<num_ongoing_trades; i++) {
+			OngoingTrade trade("");
+			if(!(input >> trade.symbol >> trade.stocks_held >> trade.buy_price >> trade.stop_loss)) {
+				return false;
+			}
+
+			auto it = trade_map.find(trade.symbol);
+			if(it == trade_map.end()) {
+				return false;
+			}
+
+			trade.trade_ongoing = true;
+			it->second = trade;
+		}
+
+		return true;
+	}
+
     int GetWins() {
     	return wins;
     }
@@ -263,4 +351,6 @@ private:
 	bool print_trade_candles;
 };
 
-}
\ No newline at end of file
+}
+
+#endif
\ No newline at end of file